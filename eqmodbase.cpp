@@ -34,9 +34,15 @@
 
 #include "mach_gettime.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
 #include <memory>
+#include <string>
 #include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <assert.h>
 #include <indicom.h>
@@ -64,6 +70,27 @@ using namespace INDI::AlignmentSubsystem;
 #define GOTO_ITERATIVE_LIMIT 5 /* Max GOTO Iterations */
 #define RAGOTORESOLUTION     5 /* GOTO Resolution in arcsecs */
 #define DEGOTORESOLUTION     5 /* GOTO Resolution in arcsecs */
+#define GOTO_LEADTIME_ITERATIONS 2 /* Fixed point iterations of the predicted slew duration */
+#define SLEW_MODEL_GAIN          0.25 /* Weight of a measured slew when refining the slew model */
+#define SLEW_MODEL_MIN_DURATION  2.0  /* Shorter slews are not used to refine the slew model, seconds */
+#define HORIZON_PREDICTION_STEP  120  /* Longest sampling step of the diurnal circle when predicting horizon limits, seconds */
+#define HORIZON_PREDICTION_ANGLE 0.1  /* Largest alt or az change between two samples, or position drift, degrees */
+#define HORIZON_CHECK_WINDOW     120  /* Check horizon limits every poll that long before the predicted time, seconds */
+#define CALIBRATION_ARC          5.0  /* Highspeed calibration slews, degrees */
+#define CALIBRATION_SAMPLE_MS    50   /* Encoder sampling during calibration slews, ms */
+#define CALIBRATION_STILL        5    /* Unchanged encoder samples ending a calibration slew */
+#define CALIBRATION_TIMEOUT      120  /* Maximum duration of a calibration slew, seconds */
+#define CALIBRATION_MIN_LOWSPEED 2000 /* Lowspeed margin needed to calibrate lowspeed gotos, microsteps */
+#define CALIBRATION_ARC_CHECKS   10   /* Positions checked against the horizon limits along a calibration arc */
+#define GOTO_QUEUE_PLAN_VALIDITY 600  /* Older precomputed queue plans are computed again, seconds */
+#define SETTLE_SAMPLE_MS         50   /* Aux encoder sampling while settling, ms */
+#define SETTLE_WINDOW            8    /* Samples over which the residual motion is measured */
+#define GUIDE_LEAD_SMOOTHING     0.2  /* Weight of the last measured restore latency */
+#define GUIDE_BATCH_WINDOW       0.002 /* Pulse starts of both axes closer than this share a batch, seconds */
+#define GUIDE_STEP_POLL_MS       20   /* DE status polling at the end of a step guide move, ms */
+#define GUIDE_TELEMETRY_MS       2000 /* Guide telemetry BLOB drain period, ms */
+#define GUIDE_BENCH_POLL_MS      10   /* Guide benchmark pulse completion polling, ms */
+#define DITHER_TICK_MS           1000 /* Tracking period dithering schedule, ms */
 
 /* Preset Slew Speeds */
 #define SLEWMODES 11
@@ -115,6 +142,61 @@ EQMod::EQMod(): GI(this)
     last_motion_ns       = -1;
     last_motion_ew       = -1;
     pulseInProgress      = 0;
+    guidethreadexit      = false;
+    guidepipe[0]         = -1;
+    guidepipe[1]         = -1;
+    GuidePipeCallback    = 0;
+    for (auto &pulse : guidepulses)
+    {
+        pulse.active = pulse.ended = pulse.deferred = pulse.starting = false;
+        pulse.rate = pulse.restorerate = 0.0;
+        pulse.requested     = 0;
+        pulse.achieved      = -1.0;
+        pulse.merges        = 0;
+        pulse.encoderbefore = 0;
+        pulse.ppec          = 0;
+    }
+    guiderestorelead[AXIS_RA] = guiderestorelead[AXIS_DE] = 0.0;
+    InitGuideRing(&guideringbuffer);
+    guidering            = &guideringbuffer;
+    guideringtail        = 0;
+    guideringfd          = -1;
+    GuideTelemetryTimer  = 0;
+    GuideBenchTimer      = 0;
+    DitherTimer          = 0;
+    ResetDither();
+    guidebenchrunning    = false;
+    guidebenchissued     = 0;
+    guidebenchtail       = 0;
+    guidebenchcommands   = 0;
+    slewmeasuring        = false;
+    LimitTimer           = 0;
+    LimitRARate          = 0.0;
+    calibrationphase     = CALIBRATION_IDLE;
+    calibrationarc       = 0;
+    settling             = false;
+    settleencodersoff    = false;
+    SettleTimer          = 0;
+    GuideOffsetTimer     = 0;
+    DEStepGuideTimer     = 0;
+    destepguiding        = false;
+    destepremainder      = 0.0;
+    destepqueuedms       = 0;
+    destepms             = 0;
+    desteprate           = 0.0;
+    destepencoder        = 0;
+    gotoqueueindex       = -1;
+    gotoqueueactive      = false;
+    gotoqueueplanned     = false;
+    gotoqueueplanjd      = 0.0;
+    GotoQueueTimer       = 0;
+    calibrationaxis      = RA_AXIS;
+    CalibrationTimer     = 0;
+#ifdef WITH_SCOPE_LIMITS
+    horizonlimitjd       = 0.0;
+    horizonlimitra       = 0.0;
+    horizonlimitdec      = 0.0;
+#endif
 
     DBG_SCOPE_STATUS = INDI::Logger::getInstance().addDebugLevel("Scope Status", "SCOPE");
     DBG_COMM         = INDI::Logger::getInstance().addDebugLevel("Serial Port", "COMM");
@@ -157,13 +239,16 @@ EQMod::EQMod(): GI(this)
     srand(time(nullptr));
     // Others
     AutohomeState      = AUTO_HOME_IDLE;
-    restartguidePPEC   = false;
+    ppecsuspended      = false;
+    PPECResumeTimer    = 0;
     
 }
 
 EQMod::~EQMod()
 {
     //dtor
+    StopGuideThread();
+    CloseGuideTelemetryFile();
     delete mount;
     mount = nullptr;
 }
@@ -348,6 +433,33 @@ void EQMod::ISGetProperties(const char *dev)
         defineProperty(TrackDefaultSP);
         defineProperty(ST4GuideRateNSSP);
         defineProperty(ST4GuideRateWESP);
+        defineProperty(SlewDurationNP);
+        defineProperty(SlewModelNP);
+        defineProperty(MotionProfileNP);
+        defineProperty(GotoCalibrationSP);
+        defineProperty(GotoQueueTP);
+        defineProperty(GotoQueueSP);
+        defineProperty(GotoQueueNP);
+        defineProperty(GotoStatsNP);
+        defineProperty(PierSideOptimizerSP);
+        defineProperty(FineApproachSP);
+        defineProperty(EmergencyStopSP);
+        defineProperty(AbortLatencyNP);
+        defineProperty(GuideOffsetNP);
+        defineProperty(GuideDEModeSP);
+        defineProperty(GuideStatsNP);
+        defineProperty(GuideTelemetrySP);
+        defineProperty(GuideTelemetryTP);
+        defineProperty(GuideTelemetryBP);
+        defineProperty(GuideBenchNP);
+        defineProperty(GuideBenchSP);
+        defineProperty(GuideBenchResultsNP);
+        defineProperty(TrackDitherSP);
+        defineProperty(TrackDitherNP);
+        defineProperty(MinTrackingTimeNP);
+        defineProperty(MeridianFlipSP);
+        defineProperty(FlipMarginNP);
+        defineProperty(LimitTimeNP);
 
 #if defined WITH_ALIGN && defined WITH_ALIGN_GEEHALEL
         defineProperty(&AlignMethodSP);
@@ -360,11 +472,15 @@ void EQMod::ISGetProperties(const char *dev)
         {
             defineProperty(AuxEncoderSP);
             defineProperty(AuxEncoderNP);
+            defineProperty(GotoSettleSP);
+            defineProperty(GotoSettleLimitsNP);
+            defineProperty(GotoSettleNP);
         }
         if (mount->HasPPEC())
         {
             defineProperty(PPECTrainingSP);
             defineProperty(PPECSP);
+            defineProperty(PPECResumeNP);
         }
         if (mount->HasSnapPort1())
         {
@@ -390,6 +506,7 @@ void EQMod::ISGetProperties(const char *dev)
         if (horizon)
         {
             horizon->ISGetProperties();
+            defineProperty(HorizonLimitTimeNP);
         }
 #endif
         simulator->updateProperties(isSimulation());
@@ -437,6 +554,167 @@ bool EQMod::loadProperties()
     LEDBrightnessNP     = getNumber("LED_BRIGHTNESS");
     SNAPPORT1SP         = getSwitch("SNAPPORT1");
     SNAPPORT2SP         = getSwitch("SNAPPORT2");
+
+    SlewDurationNP[0].fill("RA_DURATION", "RA (s)", "%.1f", 0, 3600, 0, 0);
+    SlewDurationNP[1].fill("DE_DURATION", "DE (s)", "%.1f", 0, 3600, 0, 0);
+    SlewDurationNP[2].fill("SLEW_DURATION", "Slew (s)", "%.1f", 0, 3600, 0, 0);
+    SlewDurationNP.fill(getDeviceName(), "SLEW_DURATION", "Predicted Slew", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    SlewModelNP[0].fill("RA_SCALE", "RA scale", "%.3f", 0.2, 5.0, 0.01, 1.0);
+    SlewModelNP[1].fill("DE_SCALE", "DE scale", "%.3f", 0.2, 5.0, 0.01, 1.0);
+    SlewModelNP.fill(getDeviceName(), "SLEW_MODEL", "Slew Model", MOTION_TAB, IP_RW, 0, IPS_IDLE);
+
+    MotionProfileNP[0].fill("MOUNT_CODE", "Mount code", "%.0f", 0, 255, 0, 0);
+    MotionProfileNP[1].fill("MC_VERSION", "Firmware", "%.0f", 0, 16777215, 0, 0);
+    MotionProfileNP[2].fill("RA_LOWSPEED_MARGIN", "RA highspeed above", "%.0f", 0, 16777215, 100, 0);
+    MotionProfileNP[3].fill("RA_LOW_PERIOD", "RA lowspeed period", "%.0f", 1, 255, 1, 0);
+    MotionProfileNP[4].fill("RA_HIGH_PERIOD", "RA highspeed period", "%.0f", 1, 255, 1, 0);
+    MotionProfileNP[5].fill("RA_LOW_BREAKS", "RA lowspeed breaks", "%.0f", 0, 100000, 10, 0);
+    MotionProfileNP[6].fill("RA_HIGH_BREAKS", "RA highspeed breaks", "%.0f", 0, 1000000, 100, 0);
+    MotionProfileNP[7].fill("DE_LOWSPEED_MARGIN", "DE highspeed above", "%.0f", 0, 16777215, 100, 0);
+    MotionProfileNP[8].fill("DE_LOW_PERIOD", "DE lowspeed period", "%.0f", 1, 255, 1, 0);
+    MotionProfileNP[9].fill("DE_HIGH_PERIOD", "DE highspeed period", "%.0f", 1, 255, 1, 0);
+    MotionProfileNP[10].fill("DE_LOW_BREAKS", "DE lowspeed breaks", "%.0f", 0, 100000, 10, 0);
+    MotionProfileNP[11].fill("DE_HIGH_BREAKS", "DE highspeed breaks", "%.0f", 0, 1000000, 100, 0);
+    MotionProfileNP[12].fill("RA_HIGH_FACTOR", "RA highspeed velocity factor", "%.3f", 0.1, 10.0, 0.01, 1.0);
+    MotionProfileNP[13].fill("RA_LOW_FACTOR", "RA lowspeed velocity factor", "%.3f", 0.1, 10.0, 0.01, 1.0);
+    MotionProfileNP[14].fill("RA_RAMPUP", "RA ramp-up (s)", "%.2f", 0, 30, 0.1, 1.0);
+    MotionProfileNP[15].fill("RA_RAMPDOWN", "RA ramp-down (s)", "%.2f", 0, 30, 0.1, 0);
+    MotionProfileNP[16].fill("DE_HIGH_FACTOR", "DE highspeed velocity factor", "%.3f", 0.1, 10.0, 0.01, 1.0);
+    MotionProfileNP[17].fill("DE_LOW_FACTOR", "DE lowspeed velocity factor", "%.3f", 0.1, 10.0, 0.01, 1.0);
+    MotionProfileNP[18].fill("DE_RAMPUP", "DE ramp-up (s)", "%.2f", 0, 30, 0.1, 1.0);
+    MotionProfileNP[19].fill("DE_RAMPDOWN", "DE ramp-down (s)", "%.2f", 0, 30, 0.1, 0);
+    MotionProfileNP[20].fill("RA_FINE_BREAKS", "RA final approach breaks", "%.0f", 0, 100000, 10, 0);
+    MotionProfileNP[21].fill("DE_FINE_BREAKS", "DE final approach breaks", "%.0f", 0, 100000, 10, 0);
+    MotionProfileNP.fill(getDeviceName(), "GOTO_PROFILE", "Goto Profile", MOTION_TAB, IP_RW, 0, IPS_IDLE);
+
+    GotoCalibrationSP[0].fill("CALIBRATE_RA", "Calibrate RA", ISS_OFF);
+    GotoCalibrationSP[1].fill("CALIBRATE_DE", "Calibrate DE", ISS_OFF);
+    GotoCalibrationSP.fill(getDeviceName(), "GOTO_CALIBRATION", "Goto Calibration", MOTION_TAB, IP_RW, ISR_ATMOST1, 0,
+                           IPS_IDLE);
+
+    GotoQueueTP[0].fill("TARGETS", "RA DE [dwell s]; ...", "");
+    GotoQueueTP.fill(getDeviceName(), "GOTO_QUEUE", "Goto Queue", MOTION_TAB, IP_RW, 0, IPS_IDLE);
+    GotoQueueSP[0].fill("QUEUE_NEXT", "Next", ISS_OFF);
+    GotoQueueSP[1].fill("QUEUE_CLEAR", "Clear", ISS_OFF);
+    GotoQueueSP.fill(getDeviceName(), "GOTO_QUEUE_CONTROL", "Goto Queue", MOTION_TAB, IP_RW, ISR_ATMOST1, 0, IPS_IDLE);
+    GotoQueueNP[0].fill("QUEUE_INDEX", "Target", "%.0f", 0, 1000, 0, 0);
+    GotoQueueNP[1].fill("QUEUE_COUNT", "Targets", "%.0f", 0, 1000, 0, 0);
+    GotoQueueNP.fill(getDeviceName(), "GOTO_QUEUE_STATUS", "Goto Queue", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    GotoStatsNP[0].fill("GOTO_SLEWS", "Slews", "%.0f", 0, 100, 0, 0);
+    GotoStatsNP[1].fill("GOTO_FINE_APPROACHES", "Final approaches", "%.0f", 0, 100, 0, 0);
+    GotoStatsNP[2].fill("GOTO_RA_RESIDUAL", "RA residual (arcsecs)", "%.2f", 0, 1000000, 0, 0);
+    GotoStatsNP[3].fill("GOTO_DE_RESIDUAL", "DE residual (arcsecs)", "%.2f", 0, 1000000, 0, 0);
+    GotoStatsNP.fill(getDeviceName(), "GOTO_STATS", "Last Goto", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    PierSideOptimizerSP[0].fill("PIER_OPTIMIZER_OFF", "Hour angle", ISS_ON);
+    PierSideOptimizerSP[1].fill("PIER_OPTIMIZER_ON", "Fastest slew", ISS_OFF);
+    PierSideOptimizerSP.fill(getDeviceName(), "PIER_SIDE_OPTIMIZER", "Pier Side Choice", OPTIONS_TAB, IP_RW,
+                             ISR_1OFMANY, 0, IPS_IDLE);
+
+    FineApproachSP[0].fill("FINE_APPROACH_OFF", "Slew again", ISS_ON);
+    FineApproachSP[1].fill("FINE_APPROACH_ON", "Lowspeed approach", ISS_OFF);
+    FineApproachSP.fill(getDeviceName(), "GOTO_FINE_APPROACH", "Goto Iterations", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0,
+                        IPS_IDLE);
+
+    EmergencyStopSP[0].fill("ABORT_DECELERATE", "Decelerate", ISS_ON);
+    EmergencyStopSP[1].fill("ABORT_INSTANT", "Instant stop", ISS_OFF);
+    EmergencyStopSP.fill(getDeviceName(), "ABORT_MODE", "Abort", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+    AbortLatencyNP[0].fill("ABORT_STOP_SENT", "Stops acknowledged (ms)", "%.1f", 0, 100000, 0, 0);
+    AbortLatencyNP[1].fill("ABORT_STOP_CONFIRMED", "Stop confirmed (ms)", "%.1f", 0, 100000, 0, 0);
+    AbortLatencyNP.fill(getDeviceName(), "ABORT_LATENCY", "Abort Latency", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    GuideOffsetNP[0].fill("RA_OFFSET", "RA, West + (arcsecs/s)", "%.3f", -60, 60, 0.1, 0);
+    GuideOffsetNP[1].fill("DE_OFFSET", "DE, North + (arcsecs/s)", "%.3f", -60, 60, 0.1, 0);
+    GuideOffsetNP[2].fill("OFFSET_EXPIRY", "Expiry (s, 0 = none)", "%.1f", 0, 3600, 1, 0);
+    GuideOffsetNP.fill(getDeviceName(), "GUIDE_RATE_OFFSET", "Guide Offsets", MOTION_TAB, IP_RW, 0, IPS_IDLE);
+
+    GuideDEModeSP[0].fill("DE_MODE_RATE", "Rate change", ISS_ON);
+    GuideDEModeSP[1].fill("DE_MODE_STEPS", "Step moves", ISS_OFF);
+    GuideDEModeSP.fill(getDeviceName(), "GUIDE_DE_MODE", "DE Guiding", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    GuideStatsNP[0].fill("GUIDE_PULSES", "Pulses", "%.0f", 0, 1e9, 0, 0);
+    GuideStatsNP[1].fill("GUIDE_MERGED", "Merged pulses", "%.0f", 0, 1e9, 0, 0);
+    GuideStatsNP[2].fill("GUIDE_RATE_CHANGES", "Rate changes", "%.0f", 0, 1e9, 0, 0);
+    GuideStatsNP[3].fill("GUIDE_RATE_CHANGES_SAVED", "Rate changes saved", "%.0f", 0, 1e9, 0, 0);
+    GuideStatsNP.fill(getDeviceName(), "GUIDE_STATS", "Guide Stats", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    PPECResumeNP[0].fill("PPEC_QUIET", "Quiet interval (s, 0 = each pulse)", "%.0f", 0, 600, 1, 10);
+    PPECResumeNP.fill(getDeviceName(), "GUIDE_PPEC_RESUME", "PPEC Guiding", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    GuideTelemetrySP[0].fill("TELEMETRY_OFF", "Off", ISS_ON);
+    GuideTelemetrySP[1].fill("TELEMETRY_BLOB", "BLOB", ISS_OFF);
+    GuideTelemetrySP[2].fill("TELEMETRY_MMAP", "Mapped file", ISS_OFF);
+    GuideTelemetrySP.fill(getDeviceName(), "GUIDE_TELEMETRY_MODE", "Guide Telemetry", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0,
+                          IPS_IDLE);
+    GuideTelemetryTP[0].fill("TELEMETRY_FILE", "Mapped file", "/tmp/eqmod-guide.ring");
+    GuideTelemetryTP.fill(getDeviceName(), "GUIDE_TELEMETRY_FILE", "Guide Telemetry", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+    GuideTelemetryBP[0].fill("GUIDE_RECORDS", "Pulse records", ".eqguide");
+    GuideTelemetryBP.fill(getDeviceName(), "GUIDE_TELEMETRY", "Guide Telemetry", MOTION_TAB, IP_RO, 60, IPS_IDLE);
+
+    GuideBenchNP[0].fill("BENCH_PULSES", "Pulses", "%.0f", 1, 100000, 100, 1000);
+    GuideBenchNP[1].fill("BENCH_MIN_MS", "Shortest pulse (ms)", "%.0f", 1, 10000, 10, 20);
+    GuideBenchNP[2].fill("BENCH_MAX_MS", "Longest pulse (ms)", "%.0f", 1, 10000, 10, 1000);
+    GuideBenchNP[3].fill("BENCH_LATENCY", "Link latency (ms)", "%.1f", 0, 500, 1, 0);
+    GuideBenchNP[4].fill("BENCH_SEED", "Random seed", "%.0f", 0, 1e9, 1, 1);
+    GuideBenchNP.fill(getDeviceName(), "GUIDE_BENCHMARK", "Guide Benchmark", MOTION_TAB, IP_RW, 0, IPS_IDLE);
+    GuideBenchSP[0].fill("BENCH_START", "Start", ISS_OFF);
+    GuideBenchSP[1].fill("BENCH_STOP", "Stop", ISS_OFF);
+    GuideBenchSP.fill(getDeviceName(), "GUIDE_BENCHMARK_CONTROL", "Guide Benchmark", MOTION_TAB, IP_RW, ISR_ATMOST1, 0,
+                      IPS_IDLE);
+    GuideBenchResultsNP[0].fill("BENCH_DONE", "Pulses sent", "%.0f", 0, 1e9, 0, 0);
+    GuideBenchResultsNP[1].fill("BENCH_ERROR_MEAN", "Error mean (ms)", "%.2f", -1e6, 1e6, 0, 0);
+    GuideBenchResultsNP[2].fill("BENCH_ERROR_STDDEV", "Error std dev (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[3].fill("BENCH_ERROR_P95", "|Error| 95% (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[4].fill("BENCH_ERROR_MAX", "|Error| max (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[5].fill("BENCH_CALL_MEAN", "Guide calls mean (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[6].fill("BENCH_CALL_MAX", "Guide calls max (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[7].fill("BENCH_PIPE_MEAN", "Pulse end handling mean (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[8].fill("BENCH_PIPE_MAX", "Pulse end handling max (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[9].fill("BENCH_LATENCY_MEAN", "Event loop latency mean (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[10].fill("BENCH_LATENCY_MAX", "Event loop latency max (ms)", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP[11].fill("BENCH_COMMANDS", "Commands per pulse", "%.2f", 0, 1e6, 0, 0);
+    GuideBenchResultsNP.fill(getDeviceName(), "GUIDE_BENCHMARK_RESULTS", "Guide Benchmark", MOTION_TAB, IP_RO, 0,
+                             IPS_IDLE);
+
+    GotoSettleSP[0].fill("SETTLE_OFF", "Off", ISS_ON);
+    GotoSettleSP[1].fill("SETTLE_ON", "On", ISS_OFF);
+    GotoSettleSP.fill(getDeviceName(), "GOTO_SETTLE_MONITOR", "Settle Monitor", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0,
+                      IPS_IDLE);
+    GotoSettleLimitsNP[0].fill("SETTLE_THRESHOLD", "Threshold (aux steps)", "%.0f", 0, 1000, 1, 2);
+    GotoSettleLimitsNP[1].fill("SETTLE_TIMEOUT", "Timeout (s)", "%.0f", 1, 120, 1, 10);
+    GotoSettleLimitsNP.fill(getDeviceName(), "GOTO_SETTLE_LIMITS", "Settle Limits", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+    GotoSettleNP[0].fill("SETTLE_TIME", "Settle time (s)", "%.2f", 0, 120, 0, 0);
+    GotoSettleNP.fill(getDeviceName(), "GOTO_SETTLE", "Goto Settle", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    TrackDitherSP[0].fill("DITHER_OFF", "Off", ISS_ON);
+    TrackDitherSP[1].fill("DITHER_ON", "On", ISS_OFF);
+    TrackDitherSP.fill(getDeviceName(), "TRACK_DITHER", "Period Dithering", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+    TrackDitherNP[0].fill("RA_QUANTIZATION_PPM", "RA truncated period (ppm)", "%.2f", -1e6, 1e6, 0, 0);
+    TrackDitherNP[1].fill("RA_RESIDUAL_PPM", "RA dithered (ppm)", "%.3f", -1e6, 1e6, 0, 0);
+    TrackDitherNP[2].fill("DE_QUANTIZATION_PPM", "DE truncated period (ppm)", "%.2f", -1e6, 1e6, 0, 0);
+    TrackDitherNP[3].fill("DE_RESIDUAL_PPM", "DE dithered (ppm)", "%.3f", -1e6, 1e6, 0, 0);
+    TrackDitherNP.fill(getDeviceName(), "TRACK_DITHER_ERROR", "Rate Error", MOTION_TAB, IP_RO, 0, IPS_IDLE);
+
+    MinTrackingTimeNP[0].fill("MIN_TRACKING_TIME", "Minutes", "%.0f", 0, 720, 5, 60);
+    MinTrackingTimeNP.fill(getDeviceName(), "MIN_TRACKING_TIME", "Min Tracking Time", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    MeridianFlipSP[0].fill("FLIP_WARN", "Warn", ISS_ON);
+    MeridianFlipSP[1].fill("FLIP_AUTO", "Flip", ISS_OFF);
+    MeridianFlipSP.fill(getDeviceName(), "MERIDIAN_FLIP", "At RA Limit", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    FlipMarginNP[0].fill("FLIP_MARGIN", "Minutes", "%.0f", 0, 120, 1, 10);
+    FlipMarginNP.fill(getDeviceName(), "FLIP_MARGIN", "RA Limit Margin", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    LimitTimeNP[0].fill("RA_LIMIT_TIME", "Minutes", "%.1f", 0, 1440, 0, 0);
+    LimitTimeNP.fill(getDeviceName(), "RA_LIMIT_TIME", "Time to RA Limit", MAIN_CONTROL_TAB, IP_RO, 0, IPS_IDLE);
+
+#ifdef WITH_SCOPE_LIMITS
+    HorizonLimitTimeNP[0].fill("HORIZON_LIMIT_TIME", "Minutes", "%.1f", 0, 1440, 0, 0);
+    HorizonLimitTimeNP.fill(getDeviceName(), "HORIZON_LIMIT_TIME", "Time to Horizon", MAIN_CONTROL_TAB, IP_RO, 0,
+                            IPS_IDLE);
+#endif
 #ifdef WITH_ALIGN_GEEHALEL
     align->initProperties();
 #endif
@@ -489,6 +767,7 @@ bool EQMod::updateProperties()
             }
 
             mount->InquireFeatures();
+            UpdateMotionProfiles();
             if (mount->HasHomeIndexers())
             {
                 LOG_INFO("Mount has home indexers. Enabling Autohome.");
@@ -530,6 +809,35 @@ bool EQMod::updateProperties()
         defineProperty(TrackDefaultSP);
         defineProperty(ST4GuideRateNSSP);
         defineProperty(ST4GuideRateWESP);
+        defineProperty(SlewDurationNP);
+        defineProperty(SlewModelNP);
+        defineProperty(MotionProfileNP);
+        defineProperty(GotoCalibrationSP);
+        defineProperty(GotoQueueTP);
+        defineProperty(GotoQueueSP);
+        defineProperty(GotoQueueNP);
+        defineProperty(GotoStatsNP);
+        defineProperty(PierSideOptimizerSP);
+        defineProperty(FineApproachSP);
+        defineProperty(EmergencyStopSP);
+        defineProperty(AbortLatencyNP);
+        defineProperty(GuideOffsetNP);
+        defineProperty(GuideDEModeSP);
+        defineProperty(GuideStatsNP);
+        defineProperty(GuideTelemetrySP);
+        defineProperty(GuideTelemetryTP);
+        defineProperty(GuideTelemetryBP);
+        if ((GuideTelemetrySP[1].getState() == ISS_ON) && !GuideTelemetryTimer)
+            GuideTelemetryTimer = IEAddTimer(GUIDE_TELEMETRY_MS, (IE_TCF *)guideTelemetryTimerCallback, this);
+        defineProperty(GuideBenchNP);
+        defineProperty(GuideBenchSP);
+        defineProperty(GuideBenchResultsNP);
+        defineProperty(TrackDitherSP);
+        defineProperty(TrackDitherNP);
+        defineProperty(MinTrackingTimeNP);
+        defineProperty(MeridianFlipSP);
+        defineProperty(FlipMarginNP);
+        defineProperty(LimitTimeNP);
 
 #if defined WITH_ALIGN && defined WITH_ALIGN_GEEHALEL
         defineProperty(&AlignMethodSP);
@@ -543,6 +851,9 @@ bool EQMod::updateProperties()
             {
                 defineProperty(AuxEncoderSP);
                 defineProperty(AuxEncoderNP);
+                defineProperty(GotoSettleSP);
+                defineProperty(GotoSettleLimitsNP);
+                defineProperty(GotoSettleNP);
                 LOG_INFO("Mount has auxiliary encoders. Turning them off.");
                 mount->TurnRAEncoder(false);
                 mount->TurnDEEncoder(false);
@@ -552,6 +863,7 @@ bool EQMod::updateProperties()
                 bool intraining, inppec;
                 defineProperty(PPECTrainingSP);
                 defineProperty(PPECSP);
+                defineProperty(PPECResumeNP);
                 LOG_INFO("Mount has PPEC.");
                 mount->GetPPECStatus(&intraining, &inppec);
                 if (intraining)
@@ -580,6 +892,8 @@ bool EQMod::updateProperties()
             mount->SetBacklashUseDE(UseBacklashSP.findWidgetByName("USEBACKLASHDE")->getState() == ISS_ON ? true : false);
             mount->SetBacklashRA((uint32_t)(BacklashNP.findWidgetByName("BACKLASHRA")->getValue()));
             mount->SetBacklashDE((uint32_t)(BacklashNP.findWidgetByName("BACKLASHDE")->getValue()));
+            mount->SetRAGotoScale(SlewModelNP[0].getValue());
+            mount->SetDEGotoScale(SlewModelNP[1].getValue());
 
             if (mount->HasSnapPort1())
             {
@@ -642,16 +956,47 @@ bool EQMod::updateProperties()
         deleteProperty(ST4GuideRateNSSP);
         deleteProperty(ST4GuideRateWESP);
         deleteProperty(LEDBrightnessNP);
+        deleteProperty(SlewDurationNP);
+        deleteProperty(SlewModelNP);
+        deleteProperty(MotionProfileNP);
+        deleteProperty(GotoCalibrationSP);
+        deleteProperty(GotoQueueTP);
+        deleteProperty(GotoQueueSP);
+        deleteProperty(GotoQueueNP);
+        deleteProperty(GotoStatsNP);
+        deleteProperty(PierSideOptimizerSP);
+        deleteProperty(FineApproachSP);
+        deleteProperty(EmergencyStopSP);
+        deleteProperty(AbortLatencyNP);
+        deleteProperty(GuideOffsetNP);
+        deleteProperty(GuideDEModeSP);
+        deleteProperty(GuideStatsNP);
+        deleteProperty(GuideTelemetrySP);
+        deleteProperty(GuideTelemetryTP);
+        deleteProperty(GuideTelemetryBP);
+        deleteProperty(GuideBenchNP);
+        deleteProperty(GuideBenchSP);
+        deleteProperty(GuideBenchResultsNP);
+        deleteProperty(TrackDitherSP);
+        deleteProperty(TrackDitherNP);
+        deleteProperty(MinTrackingTimeNP);
+        deleteProperty(MeridianFlipSP);
+        deleteProperty(FlipMarginNP);
+        deleteProperty(LimitTimeNP);
 
         if (mount->HasAuxEncoders())
         {
             deleteProperty(AuxEncoderSP);
             deleteProperty(AuxEncoderNP);
+            deleteProperty(GotoSettleSP);
+            deleteProperty(GotoSettleLimitsNP);
+            deleteProperty(GotoSettleNP);
         }
         if (mount->HasPPEC())
         {
             deleteProperty(PPECTrainingSP);
             deleteProperty(PPECSP);
+            deleteProperty(PPECResumeNP);
         }
         if (mount->HasSnapPort1())
         {
@@ -687,6 +1032,10 @@ bool EQMod::updateProperties()
     {
         if (!horizon->updateProperties())
             return false;
+        if (isConnected())
+            defineProperty(HorizonLimitTimeNP);
+        else
+            deleteProperty(HorizonLimitTimeNP);
     }
 #endif
 
@@ -754,6 +1103,23 @@ bool EQMod::Disconnect()
 {
     if (isConnected())
     {
+        CancelLimitTimer();
+        if (calibrationphase != CALIBRATION_IDLE)
+            CancelCalibration("disconnecting");
+        StopGotoQueue();
+        StopSettle(IPS_IDLE);
+        StopGuideBenchmark(IPS_IDLE);
+        ClearGuideOffsets();
+        StopDEStepGuide();
+        StopGuideThread();
+        CancelPPECResume();
+        ppecsuspended = false;
+        // The BLOB is deleted with the other properties, drained again once connected
+        if (GuideTelemetryTimer)
+        {
+            IERmTimer(GuideTelemetryTimer);
+            GuideTelemetryTimer = 0;
+        }
         try
         {
             mount->Disconnect();
@@ -973,10 +1339,12 @@ bool EQMod::ReadScopeStatus()
             AuxEncoderNP.apply();
         }
 
-        if (gotoInProgress())
+        // Gotos and parks wait for their asynchronous stops before slewing
+        if (gotoInProgress() && !mount->IsMotionPending())
         {
             if (!(mount->IsRARunning()) && !(mount->IsDERunning()))
             {
+                EndSlewDuration();
                 // Goto iteration
                 gotoparams.iterative_count += 1;
                 LOGF_INFO(
@@ -991,14 +1359,39 @@ bool EQMod::ReadScopeStatus()
                     gotoparams.decurrent        = currentDEC;
                     gotoparams.racurrentencoder = currentRAEncoder;
                     gotoparams.decurrentencoder = currentDEEncoder;
+                    gotoparams.fineapproach     = (FineApproachSP[1].getState() == ISS_ON);
                     EncoderTarget(&gotoparams);
-                    // Start iterative slewing
-                    LOGF_INFO(
-                        "Iterative goto (%d): slew mount to RA increment = %d, DE increment = %d",
-                        gotoparams.iterative_count, static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
-                        static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
-                    mount->SlewTo(static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
-                                  static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+                    // Misses beyond the lowspeed margins need a full slew again
+                    if (gotoparams.fineapproach &&
+                            ((std::abs(static_cast<int32_t>(gotoparams.ratargetencoder - gotoparams.racurrentencoder)) >
+                              static_cast<int32_t>(mount->GetRAMotionProfile().lowspeedmargin)) ||
+                             (std::abs(static_cast<int32_t>(gotoparams.detargetencoder - gotoparams.decurrentencoder)) >
+                              static_cast<int32_t>(mount->GetDEMotionProfile().lowspeedmargin))))
+                    {
+                        gotoparams.fineapproach = false;
+                        EncoderTarget(&gotoparams);
+                    }
+                    if (gotoparams.fineapproach)
+                    {
+                        // Lowspeed final approach aimed at where the target is when it ends
+                        gotoparams.fine_count += 1;
+                        LOGF_INFO(
+                            "Iterative goto (%d): final approach to RA increment = %d, DE increment = %d (lead time %.2f s)",
+                            gotoparams.iterative_count, static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                            static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder), gotoparams.leadtime);
+                        mount->FineSlewTo(static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                                          static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+                    }
+                    else
+                    {
+                        // Start iterative slewing
+                        LOGF_INFO(
+                            "Iterative goto (%d): slew mount to RA increment = %d, DE increment = %d",
+                            gotoparams.iterative_count, static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                            static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+                        mount->SlewTo(static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                                      static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+                    }
                 }
                 else
                 {
@@ -1013,6 +1406,18 @@ bool EQMod::ReadScopeStatus()
                             3600 * fabs(gotoparams.detarget - currentDEC));
                     }
 
+                    LOGF_INFO("Goto completed in %d slew(s), %d final approach(es): RA residual = %4.2f arcsecs "
+                              "DE residual = %4.2f arcsecs (lead time %.2f s)",
+                              gotoparams.iterative_count, gotoparams.fine_count, 3600 * fabs(gotoparams.ratarget - currentRA),
+                              3600 * fabs(gotoparams.detarget - currentDEC), gotoparams.leadtime);
+                    GotoStatsNP[0].setValue(gotoparams.iterative_count);
+                    GotoStatsNP[1].setValue(gotoparams.fine_count);
+                    GotoStatsNP[2].setValue(3600 * fabs(gotoparams.ratarget - currentRA));
+                    GotoStatsNP[3].setValue(3600 * fabs(gotoparams.detarget - currentDEC));
+                    GotoStatsNP.setState(((GotoStatsNP[2].getValue() > RAGOTORESOLUTION) ||
+                                          (GotoStatsNP[3].getValue() > DEGOTORESOLUTION)) ? IPS_ALERT : IPS_OK);
+                    GotoStatsNP.apply();
+
                     // For AstroEQ (needs an explicit :G command at the end of gotos)
                     mount->ResetMotions();
 
@@ -1025,12 +1430,14 @@ bool EQMod::ReadScopeStatus()
                             name = TrackModeSP.findOnSwitchName();;
                             mount->StartRATracking(GetRATrackRate());
                             mount->StartDETracking(GetDETrackRate());
+                            LimitRARate = GetRATrackRate();
                         }
                         else
                         {
                             name = TrackDefaultSP.findOnSwitchName();
                             mount->StartRATracking(GetDefaultRATrackRate());
                             mount->StartDETracking(GetDefaultDETrackRate());
+                            LimitRARate = GetDefaultRATrackRate();
 
 #if 0
                             IUResetSwitch(TrackModeSP);
@@ -1042,6 +1449,10 @@ bool EQMod::ReadScopeStatus()
 
                         TrackState = SCOPE_TRACKING;
                         RememberTrackState = TrackState;
+                        ScheduleLimitTimer(LimitRARate);
+#ifdef WITH_SCOPE_LIMITS
+                        PredictHorizonLimit();
+#endif
 
 #if 0
                         TrackModeSP->s = IPS_BUSY;
@@ -1056,6 +1467,8 @@ bool EQMod::ReadScopeStatus()
                         LOG_INFO("Telescope slew is complete. Stopping...");
                     }
                     gotoparams.completed = true;
+                    StartSettle();
+                    GotoQueueArrived();
                 }
             }
         }
@@ -1063,15 +1476,33 @@ bool EQMod::ReadScopeStatus()
 #ifdef WITH_SCOPE_LIMITS
         if (horizon)
         {
-            if (horizon->checkLimits(horizvalues[0], horizvalues[1], TrackState, gotoInProgress()))
-                Abort();
+            // While tracking the crossing is predicted: only check from a margin before it, or once the
+            // position moved away from the predicted track
+            if ((TrackState != SCOPE_TRACKING) || (horizonlimitjd == 0.0) ||
+                    (juliandate >= horizonlimitjd - (HORIZON_CHECK_WINDOW / 86400.0)) ||
+                    (fabs(alignedRA - horizonlimitra) * 15.0 > HORIZON_PREDICTION_ANGLE) ||
+                    (fabs(alignedDEC - horizonlimitdec) > HORIZON_PREDICTION_ANGLE))
+            {
+                if (horizon->checkLimits(horizvalues[0], horizvalues[1], TrackState, gotoInProgress()))
+                    Abort();
+            }
+            if ((TrackState == SCOPE_TRACKING) && (horizonlimitjd != 0.0))
+            {
+                double minutes = std::max(0.0, (horizonlimitjd - juliandate) * 1440.0);
+                if (fabs(minutes - HorizonLimitTimeNP[0].getValue()) >= 1.0)
+                {
+                    HorizonLimitTimeNP[0].setValue(minutes);
+                    HorizonLimitTimeNP.apply();
+                }
+            }
         }
 #endif
 
-        if (TrackState == SCOPE_PARKING)
+        if ((TrackState == SCOPE_PARKING) && !mount->IsMotionPending())
         {
             if (!(mount->IsRARunning()) && !(mount->IsDERunning()))
             {
+                EndSlewDuration();
                 currentRAEncoder = mount->GetRAEncoder();
                 currentDEEncoder = mount->GetDEEncoder();
                 parkRAEncoder    = GetAxis1Park();
@@ -1611,920 +2042,3022 @@ double EQMod::EncoderFromDec(double detarget, TelescopePierSide p, uint32_t init
     return EncoderFromDegree(detarget, initstep, totalstep, h);
 }
 
-void EQMod::SetSouthernHemisphere(bool southern)
+/*
+ * Choose the pier side giving the shortest slew among the sides inside the RA limits and leaving at least
+ * the minimum tracking time before the west limit. Horizon limits do not depend on the pier side and are
+ * checked by Goto. Returns PIER_UNKNOWN when no side qualifies.
+ */
+TelescopePierSide EQMod::OptimalPierSide(GotoParams *g, double lst)
 {
-    const char *hemispherenames[] = { "NORTH", "SOUTH" };
-    ISState hemispherevalues[2];
-    LOGF_DEBUG("Set southern %s", (southern ? "true" : "false"));
-    if (southern)
-        Hemisphere = SOUTH;
-    else
-        Hemisphere = NORTH;
-    RAInverted = (Hemisphere == SOUTH);
-    UpdateDEInverted();
-    if (Hemisphere == NORTH)
+    const TelescopePierSide sides[2] = { PIER_EAST, PIER_WEST };
+    TelescopePierSide best           = PIER_UNKNOWN;
+    double bestduration = 0.0, duration, trackingtime;
+    uint32_t raencoder, deencoder;
+    bool outside;
+
+    for (const auto side : sides)
     {
-        hemispherevalues[0] = ISS_ON;
-        hemispherevalues[1] = ISS_OFF;
-        HemisphereSP.update(hemispherevalues, (char **)hemispherenames, 2);
+        raencoder = EncoderFromRA(g->ratarget, side, lst, zeroRAEncoder, totalRAEncoder, Hemisphere);
+        deencoder = EncoderFromDec(g->detarget, side, zeroDEEncoder, totalDEEncoder, Hemisphere);
+        if (Hemisphere == NORTH)
+            outside = (raencoder < g->limiteast) || (raencoder > g->limitwest);
+        else
+            outside = (raencoder > g->limiteast) || (raencoder < g->limitwest);
+        trackingtime = RALimitTime(raencoder, g->limiteast, g->limitwest, GetDefaultRATrackRate());
+        duration     = std::max(mount->GetRAGotoDuration(static_cast<int32_t>(raencoder - g->racurrentencoder)),
+                                mount->GetDEGotoDuration(static_cast<int32_t>(deencoder - g->decurrentencoder)));
+        DEBUGF(DBG_MOUNT, "Pier side %s: %s limits, slew %.1f s, tracking %.0f min",
+               (side == PIER_EAST ? "East" : "West"), (outside ? "outside" : "inside"), duration, trackingtime / 60.0);
+        if (outside || (trackingtime < 60.0 * MinTrackingTimeNP[0].getValue()))
+            continue;
+        if ((best == PIER_UNKNOWN) || (duration < bestduration))
+        {
+            best         = side;
+            bestduration = duration;
+        }
     }
+    if (best != PIER_UNKNOWN)
+        LOGF_INFO("Fastest pier side: %s (slew %.1f s)", (best == PIER_EAST ? "East" : "West"), bestduration);
     else
+        LOG_WARN("No pier side leaves the minimum tracking time, using the hour angle.");
+    return best;
+}
+
+/*
+ * Seconds before the RA encoder reaches the limit it is moving to when tracking at rarate (arcsec/s).
+ * Positive rates increase the encoder.
+ */
+double EQMod::RALimitTime(uint32_t raencoder, uint32_t limiteast, uint32_t limitwest, double rarate)
+{
+    double stepspersec = fabs(rarate) * totalRAEncoder / 1296000.0;
+    uint32_t limit;
+
+    if (stepspersec <= 0.0)
+        return HUGE_VAL;
+    if (rarate > 0.0)
     {
-        hemispherevalues[0] = ISS_OFF;
-        hemispherevalues[1] = ISS_ON;
-        HemisphereSP.update(hemispherevalues, (char **)hemispherenames, 2);
+        limit = std::max(limiteast, limitwest);
+        return (raencoder >= limit) ? 0.0 : (limit - raencoder) / stepspersec;
     }
-    HemisphereSP.setState(IPS_IDLE);
-    HemisphereSP.apply();
+    limit = std::min(limiteast, limitwest);
+    return (raencoder <= limit) ? 0.0 : (raencoder - limit) / stepspersec;
 }
 
-void EQMod::UpdateDEInverted()
+void EQMod::GetRALimits(uint32_t *limiteast, uint32_t *limitwest)
 {
-    bool prev = DEInverted;
-    DEInverted = (Hemisphere == SOUTH) ^ (ReverseDECSP[0].getState() == ISS_ON);
-    if (DEInverted != prev)
-        LOGF_DEBUG("Set DEInverted %s", DEInverted ? "true" : "false");
+#ifdef EQMODE_EXT
+    int64_t delta;
+    delta = ((totalRAEncoder / 4) + (totalRAEncoder / 24)); // 7 hours
+    if (Hemisphere == NORTH)
+    {
+        *limiteast = mount->GetRANorthEncoder() - delta;
+        *limitwest = mount->GetRANorthEncoder() + delta;
+    }
+    else
+    {
+        *limiteast = mount->GetRANorthEncoder() + delta;
+        *limitwest = mount->GetRANorthEncoder() - delta;
+    }
+#else
+    if (Hemisphere == NORTH)
+    {
+        *limiteast = zeroRAEncoder - (totalRAEncoder / 4) - (totalRAEncoder / 24); // 13h
+        *limitwest = zeroRAEncoder + (totalRAEncoder / 4) + (totalRAEncoder / 24); // 23h
+    }
+    else
+    {
+        *limiteast = zeroRAEncoder + (totalRAEncoder / 4) + (totalRAEncoder / 24); // ??
+        *limitwest = zeroRAEncoder - (totalRAEncoder / 4) - (totalRAEncoder / 24); // ??
+    }
+#endif
 }
 
-void EQMod::EncoderTarget(GotoParams *g)
+/*
+ * Compute when tracking at rarate (arcsec/s) reaches the RA limit and arm a single timer
+ * FLIP_MARGIN minutes before. Call it whenever tracking starts or its rate changes.
+ */
+void EQMod::ScheduleLimitTimer(double rarate)
 {
-    double r, d;
-    double ha = 0.0;
-    double juliandate;
-    double lst;
-    uint32_t targetraencoder = 0, targetdecencoder = 0;
-    bool outsidelimits = false;
-    r                  = g->ratarget;
-    d                  = g->detarget;
+    uint32_t limiteast, limitwest;
+    double limittime, delay;
 
-    juliandate = getJulianDate();
-    lst        = getLst(juliandate, getLongitude());
+    CancelLimitTimer();
+    LimitRARate = rarate;
+    if (TrackState != SCOPE_TRACKING)
+        return;
 
-    if (g->pier_side == PIER_UNKNOWN)
+    GetRALimits(&limiteast, &limitwest);
+    currentRAEncoder = mount->GetRAEncoder();
+    limittime        = RALimitTime(currentRAEncoder, limiteast, limitwest, rarate);
+    if (limittime == HUGE_VAL)
+        return;
+
+    LimitTimeNP[0].setValue(limittime / 60.0);
+    LimitTimeNP.setState(IPS_BUSY);
+    LimitTimeNP.apply();
+
+    // Timer delays are ints in ms: far away limits are rescheduled when the timer fires
+    delay = std::max(0.0, limittime - (60.0 * FlipMarginNP[0].getValue()));
+    delay = std::min(delay, 86400.0);
+    LimitTimer = IEAddTimer(static_cast<int>(delay * 1000.0), (IE_TCF *)limitTimerCallback, this);
+    DEBUGF(DBG_SCOPE_STATUS, "RA limit reached in %.1f minutes, timer in %.1f minutes", limittime / 60.0, delay / 60.0);
+}
+
+void EQMod::CancelLimitTimer()
+{
+    if (LimitTimer)
     {
-        // decide pier side and keep it consistent in iterative calls
-        ha = rangeHA(r - lst);
-        if (ha < 0.0)
-        {
-            // target WEST
-            g->pier_side = PIER_EAST;
-        }
-        else
-        {
-            g->pier_side = PIER_WEST;
-        }
+        IERmTimer(LimitTimer);
+        LimitTimer = 0;
+    }
+    if (LimitTimeNP.getState() != IPS_IDLE)
+    {
+        LimitTimeNP.setState(IPS_IDLE);
+        LimitTimeNP.apply();
     }
+}
 
-    targetraencoder  = EncoderFromRA(r, g->pier_side, lst, zeroRAEncoder, totalRAEncoder, Hemisphere);
-    targetdecencoder = EncoderFromDec(d, g->pier_side, zeroDEEncoder, totalDEEncoder, Hemisphere);
+void EQMod::limitTimerCallback(void *userpointer)
+{
+    EQMod *p      = ((EQMod *)userpointer);
+    p->LimitTimer = 0;
+    p->LimitTimerHit();
+}
 
-    if (g->checklimits)
+void EQMod::LimitTimerHit()
+{
+    uint32_t limiteast, limitwest;
+    double limittime;
+    TelescopePierSide flipside;
+
+    if (TrackState != SCOPE_TRACKING)
+        return;
+    try
     {
-        if (Hemisphere == NORTH)
+        GetRALimits(&limiteast, &limitwest);
+        currentRAEncoder = mount->GetRAEncoder();
+        limittime        = RALimitTime(currentRAEncoder, limiteast, limitwest, LimitRARate);
+        if (limittime > (60.0 * FlipMarginNP[0].getValue()) + 1.0)
         {
-            assert(g->limiteast <= g->limitwest);
-            if ((targetraencoder < g->limiteast) || (targetraencoder > g->limitwest))
-                outsidelimits = true;
+            ScheduleLimitTimer(LimitRARate);
+            return;
         }
-        else
+
+        LimitTimeNP[0].setValue(limittime / 60.0);
+        LimitTimeNP.setState(IPS_ALERT);
+        LimitTimeNP.apply();
+        LOGF_WARN("Tracking reaches the RA limit in %.1f minutes.", limittime / 60.0);
+
+        if (MeridianFlipSP[1].getState() == ISS_ON)
         {
-            assert(g->limiteast >= g->limitwest);
-            if ((targetraencoder > g->limiteast) || (targetraencoder < g->limitwest))
-                outsidelimits = true;
+            flipside = (getPierSide() == PIER_WEST) ? PIER_EAST : PIER_WEST;
+            LOGF_INFO("Starting meridian flip to pier side %s.", (flipside == PIER_EAST ? "East" : "West"));
+            if (!StartGoto(EqNP[AXIS_RA].getValue(), EqNP[AXIS_DE].getValue(), flipside))
+                LOG_ERROR("Meridian flip failed.");
         }
     }
-    g->outsidelimits   = outsidelimits;
-    g->ratargetencoder = targetraencoder;
-    g->detargetencoder = targetdecencoder;
+    catch (EQModError e)
+    {
+        e.DefaultHandleException(this);
+    }
 }
 
-double EQMod::GetRATrackRate()
+#ifdef WITH_SCOPE_LIMITS
+// Largest of the altitude and azimuth changes between two samples, degrees
+static double HorizonSampleDistance(const INDI::IHorizontalCoordinates &a, const INDI::IHorizontalCoordinates &b)
 {
-    double rate = 0.0;
-    ISwitch *sw;
-    sw = TrackModeSP.findOnSwitch();
-    if (!sw)
-        return 0.0;
-    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
+    double daz = fabs(a.azimuth - b.azimuth);
+
+    return std::max(fabs(a.altitude - b.altitude), std::min(daz, 360.0 - daz));
+}
+
+/*
+ * Solve along the diurnal circle of the current position for the next time the sidereal track
+ * leaves the horizon limits. Unknown (checked every poll) when not tracking at the sidereal rate.
+ * The step adapts so that the track never moves more than HORIZON_PREDICTION_ANGLE in altitude or
+ * azimuth between two samples, and the crossing is then bisected to about a second. The limits are
+ * checked every poll from HORIZON_CHECK_WINDOW before the crossing, or once the position drifted.
+ */
+void EQMod::PredictHorizonLimit()
+{
+    INDI::IEquatorialCoordinates radec;
+    INDI::IHorizontalCoordinates altaz, last;
+    double jd, low, high, mid, distance;
+    double step = HORIZON_PREDICTION_STEP / 86400.0;
+    auto sw = TrackModeSP.findOnSwitch();
+
+    horizonlimitjd = 0.0;
+    if (!horizon || (TrackState != SCOPE_TRACKING) || !sw || !sw->isNameMatch("TRACK_SIDEREAL"))
     {
-        rate = TRACKRATE_SIDEREAL;
+        HorizonLimitTimeNP.setState(IPS_IDLE);
+        HorizonLimitTimeNP.apply();
+        return;
     }
-    else if (!strcmp(sw->name, "TRACK_LUNAR"))
+
+    radec.rightascension = alignedRA;
+    radec.declination    = alignedDEC;
+    jd                   = getJulianDate();
+    low                  = jd;
+    high                 = jd;
+    INDI::EquatorialToHorizontal(&radec, &m_Location, jd, &last);
+    if (horizon->inGotoLimits(last.azimuth, last.altitude))
     {
-        rate = TRACKRATE_LUNAR;
+        while (low < jd + 1.0)
+        {
+            high = low + step;
+            INDI::EquatorialToHorizontal(&radec, &m_Location, high, &altaz);
+            distance = HorizonSampleDistance(last, altaz);
+            if ((distance > HORIZON_PREDICTION_ANGLE) && (step > 1.0 / 86400.0))
+            {
+                step /= 2.0;
+                continue;
+            }
+            if (!horizon->inGotoLimits(altaz.azimuth, altaz.altitude))
+                break;
+            low  = high;
+            last = altaz;
+            if (distance < HORIZON_PREDICTION_ANGLE / 2.0)
+                step = std::min(2.0 * step, HORIZON_PREDICTION_STEP / 86400.0);
+        }
     }
-    else if (!strcmp(sw->name, "TRACK_SOLAR"))
+    if (low >= jd + 1.0)
     {
-        rate = TRACKRATE_SOLAR;
+        // Never leaves the limits within a day
+        horizonlimitjd = jd + 1.0;
     }
-    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
+    else if (high == jd)
     {
-        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_RA");
-        if(number)
-            rate = number->getValue();
+        horizonlimitjd = jd;
     }
     else
-        return 0.0;
-    if (RAInverted)
-        rate = -rate;
-    return rate;
+    {
+        // Refine to about a second
+        while ((high - low) * 86400.0 > 1.0)
+        {
+            mid = (low + high) / 2.0;
+            INDI::EquatorialToHorizontal(&radec, &m_Location, mid, &altaz);
+            if (horizon->inGotoLimits(altaz.azimuth, altaz.altitude))
+                low = mid;
+            else
+                high = mid;
+        }
+        horizonlimitjd = high;
+    }
+    horizonlimitra  = alignedRA;
+    horizonlimitdec = alignedDEC;
+
+    HorizonLimitTimeNP[0].setValue((horizonlimitjd - jd) * 1440.0);
+    HorizonLimitTimeNP.setState(IPS_BUSY);
+    HorizonLimitTimeNP.apply();
+    LOGF_INFO("Tracking reaches the horizon limits in %.1f minutes.", (horizonlimitjd - jd) * 1440.0);
 }
+#endif
 
-double EQMod::GetDETrackRate()
+// Show the goto profiles in use
+void EQMod::UpdateMotionProfiles()
 {
-    double rate = 0.0;
-    ISwitch *sw;
-    sw = TrackModeSP.findOnSwitch();
-    if (!sw)
-        return 0.0;
-    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
-    {
-        rate = 0.0;
-    }
-    else if (!strcmp(sw->name, "TRACK_LUNAR"))
-    {
-        rate = 0.0;
-    }
-    else if (!strcmp(sw->name, "TRACK_SOLAR"))
-    {
-        rate = 0.0;
-    }
-    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
-    {
-        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_DE");
-        if(number)
-            rate = number->getValue();
-    }
+    Skywatcher::MotionProfile raprofile = mount->GetRAMotionProfile();
+    Skywatcher::MotionProfile deprofile = mount->GetDEMotionProfile();
+
+    MotionProfileNP[0].setValue(mount->GetMountCode());
+    MotionProfileNP[1].setValue(mount->GetMCVersion());
+    MotionProfileNP[2].setValue(raprofile.lowspeedmargin);
+    MotionProfileNP[3].setValue(raprofile.lowperiod);
+    MotionProfileNP[4].setValue(raprofile.highperiod);
+    MotionProfileNP[5].setValue(raprofile.lowbreaks);
+    MotionProfileNP[6].setValue(raprofile.highbreaks);
+    MotionProfileNP[7].setValue(deprofile.lowspeedmargin);
+    MotionProfileNP[8].setValue(deprofile.lowperiod);
+    MotionProfileNP[9].setValue(deprofile.highperiod);
+    MotionProfileNP[10].setValue(deprofile.lowbreaks);
+    MotionProfileNP[11].setValue(deprofile.highbreaks);
+    MotionProfileNP[12].setValue(raprofile.highfactor);
+    MotionProfileNP[13].setValue(raprofile.lowfactor);
+    MotionProfileNP[14].setValue(raprofile.rampup);
+    MotionProfileNP[15].setValue(raprofile.rampdown);
+    MotionProfileNP[16].setValue(deprofile.highfactor);
+    MotionProfileNP[17].setValue(deprofile.lowfactor);
+    MotionProfileNP[18].setValue(deprofile.rampup);
+    MotionProfileNP[19].setValue(deprofile.rampdown);
+    MotionProfileNP[20].setValue(raprofile.finebreaks);
+    MotionProfileNP[21].setValue(deprofile.finebreaks);
+    MotionProfileNP.setState(IPS_OK);
+    MotionProfileNP.apply();
+}
+
+void EQMod::StartSlewDuration(int32_t deltaraencoder, int32_t deltadeencoder)
+{
+    slewpredicted[RA_AXIS]  = mount->GetRAGotoDuration(deltaraencoder);
+    slewpredicted[DEC_AXIS] = mount->GetDEGotoDuration(deltadeencoder);
+    clock_gettime(CLOCK_MONOTONIC, &slewstarttime);
+    slewmeasuring = true;
+
+    SlewDurationNP[0].setValue(slewpredicted[RA_AXIS]);
+    SlewDurationNP[1].setValue(slewpredicted[DEC_AXIS]);
+    SlewDurationNP[2].setValue(std::max(slewpredicted[RA_AXIS], slewpredicted[DEC_AXIS]));
+    SlewDurationNP.setState(IPS_BUSY);
+    SlewDurationNP.apply();
+    LOGF_INFO("Predicted slew duration: RA = %.1f s, DE = %.1f s", slewpredicted[RA_AXIS], slewpredicted[DEC_AXIS]);
+}
+
+void EQMod::EndSlewDuration()
+{
+    struct timespec endtime;
+    double measured, predicted, ratio, scale;
+    int axis;
+
+    if (!slewmeasuring)
+        return;
+    slewmeasuring = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &endtime);
+    // The stop is noticed half a polling period late on average
+    measured = (endtime.tv_sec - slewstarttime.tv_sec) + ((endtime.tv_nsec - slewstarttime.tv_nsec) / 1e9) -
+               (getCurrentPollingPeriod() / 2000.0);
+    axis      = (slewpredicted[RA_AXIS] >= slewpredicted[DEC_AXIS]) ? RA_AXIS : DEC_AXIS;
+    predicted = slewpredicted[axis];
+    LOGF_INFO("Slew duration: measured %.1f s, predicted %.1f s", measured, predicted);
+    SlewDurationNP.setState(IPS_OK);
+    SlewDurationNP.apply();
+
+    // Only refine the axis which determined the slew duration, and only on slews long enough
+    // against the polling period
+    if ((predicted < SLEW_MODEL_MIN_DURATION) || (slewpredicted[1 - axis] > 0.8 * predicted) || (measured <= 0.0))
+        return;
+    ratio = std::min(2.0, std::max(0.5, measured / predicted));
+    scale = SlewModelNP[axis].getValue() * (1.0 + SLEW_MODEL_GAIN * (ratio - 1.0));
+    scale = std::min(SlewModelNP[axis].getMax(), std::max(SlewModelNP[axis].getMin(), scale));
+    SlewModelNP[axis].setValue(scale);
+    if (axis == RA_AXIS)
+        mount->SetRAGotoScale(scale);
     else
-        return 0.0;
-    if (DEInverted)
-        rate = -rate;
-    return rate;
+        mount->SetDEGotoScale(scale);
+    SlewModelNP.apply();
+    DEBUGF(DBG_MOUNT, "Refined %s slew model scale to %.3f", (axis == RA_AXIS ? "RA" : "DE"), scale);
 }
 
-double EQMod::GetDefaultRATrackRate()
+// Goto calibration, run from an idle unparked mount on one axis
+bool EQMod::StartCalibration(int axis)
 {
-    double rate = 0.0;
-    auto element = TrackDefaultSP.findOnSwitch();
-    if (!element)
-        return 0.0;
-    if (element->isNameMatch("TRACK_SIDEREAL"))
-    {
-        rate = TRACKRATE_SIDEREAL;
-    }
-    else if (element->isNameMatch("TRACK_LUNAR"))
+    Skywatcher::MotionProfile profile;
+
+    if ((TrackState != SCOPE_IDLE) || isParked())
     {
-        rate = TRACKRATE_LUNAR;
+        LOG_WARN("Goto calibration needs an idle, unparked mount: stop tracking first.");
+        return false;
     }
-    else if (element->isNameMatch("TRACK_SOLAR"))
+    profile = (axis == RA_AXIS) ? mount->GetRAMotionProfile() : mount->GetDEMotionProfile();
+    if (profile.lowspeedmargin < CALIBRATION_MIN_LOWSPEED)
     {
-        rate = TRACKRATE_SOLAR;
+        LOGF_WARN("Goto calibration: %s lowspeed margin too small to calibrate lowspeed gotos.",
+                  (axis == RA_AXIS ? "RA" : "DE"));
+        return false;
     }
-    else if (element->isNameMatch("TRACK_CUSTOM"))
+    calibrationarc = CalibrationArc(axis);
+    if (calibrationarc == 0)
     {
-        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_RA");
-        if(number)
-            rate = number->getValue();
+        LOGF_WARN("Goto calibration: a %.1f degrees %s slew would leave the mount limits in both directions.",
+                  CALIBRATION_ARC, (axis == RA_AXIS ? "RA" : "DE"));
+        return false;
     }
-    else
-        return 0.0;
-    if (RAInverted)
-        rate = -rate;
-    return rate;
+    ClearGuideOffsets();
+    calibrationaxis  = axis;
+    calibrationphase = CALIBRATION_HIGH_OUT;
+    TrackState       = SCOPE_SLEWING;
+    GotoCalibrationSP.setState(IPS_BUSY);
+    GotoCalibrationSP.apply();
+    LOGF_INFO("Starting %s goto calibration: the axis moves %.1f degrees and back, twice.",
+              (axis == RA_AXIS ? "RA" : "DE"), CALIBRATION_ARC);
+    StartCalibrationPhase();
+    return true;
 }
 
-double EQMod::GetDefaultDETrackRate()
+// Outward highspeed slew: forward when that arc is safe, otherwise backward, 0 when neither is
+int32_t EQMod::CalibrationArc(int axis)
 {
-    double rate = 0.0;
-    ISwitch *sw;
-    sw = TrackDefaultSP.findOnSwitch();
-    if (!sw)
-        return 0.0;
-    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
+    Skywatcher::MotionProfile profile = (axis == RA_AXIS) ? mount->GetRAMotionProfile() : mount->GetDEMotionProfile();
+    uint32_t total = (axis == RA_AXIS) ? totalRAEncoder : totalDEEncoder;
+    int32_t arc    = std::max(static_cast<int32_t>(total * CALIBRATION_ARC / 360.0),
+                              static_cast<int32_t>(4 * profile.lowspeedmargin));
+
+    if (CalibrationArcSafe(axis, arc))
+        return arc;
+    if (CalibrationArcSafe(axis, -arc))
+        return -arc;
+    return 0;
+}
+
+/*
+ * A calibration slew moves one axis by delta microsteps from the current position: its end must be
+ * within the RA limits used by gotos, and with horizon limits the whole arc within the goto limits.
+ */
+bool EQMod::CalibrationArcSafe(int axis, int32_t delta)
+{
+    uint32_t limiteast, limitwest, target;
+
+    if (axis == RA_AXIS)
     {
-        rate = 0.0;
+        target = currentRAEncoder + delta;
+        GetRALimits(&limiteast, &limitwest);
+        if ((target < std::min(limiteast, limitwest)) || (target > std::max(limiteast, limitwest)))
+            return false;
     }
-    else if (!strcmp(sw->name, "TRACK_LUNAR"))
+#ifdef WITH_SCOPE_LIMITS
+    if (horizon)
     {
-        rate = 0.0;
+        INDI::IEquatorialCoordinates radec;
+        INDI::IHorizontalCoordinates altaz;
+        TelescopePierSide pier;
+        double juliandate = getJulianDate();
+        double lst        = getLst(juliandate, getLongitude());
+        double ha;
+
+        for (int i = 1; i <= CALIBRATION_ARC_CHECKS; i++)
+        {
+            int32_t step = static_cast<int32_t>((static_cast<int64_t>(delta) * i) / CALIBRATION_ARC_CHECKS);
+            EncodersToRADec(currentRAEncoder + ((axis == RA_AXIS) ? step : 0),
+                            currentDEEncoder + ((axis == RA_AXIS) ? 0 : step), lst, &radec.rightascension,
+                            &radec.declination, &ha, &pier);
+            INDI::EquatorialToHorizontal(&radec, &m_Location, juliandate, &altaz);
+            if (!horizon->inGotoLimits(altaz.azimuth, altaz.altitude))
+                return false;
+        }
     }
-    else if (!strcmp(sw->name, "TRACK_SOLAR"))
+#endif
+    return true;
+}
+
+void EQMod::StartCalibrationPhase()
+{
+    Skywatcher::MotionProfile profile;
+    uint32_t current;
+    int32_t delta;
+    CalibrationSample sample;
+
+    try
     {
-        rate = 0.0;
+        if (calibrationaxis == RA_AXIS)
+        {
+            profile = mount->GetRAMotionProfile();
+            current = mount->GetRAEncoder();
+        }
+        else
+        {
+            profile = mount->GetDEMotionProfile();
+            current = mount->GetDEEncoder();
+        }
+        // Outward slews stay within the checked arc, return slews go back to where the outward slew started
+        if (calibrationphase == CALIBRATION_HIGH_OUT)
+            delta = calibrationarc;
+        else if (calibrationphase == CALIBRATION_LOW_OUT)
+            delta = static_cast<int32_t>(0.9 * profile.lowspeedmargin) * ((calibrationarc < 0) ? -1 : 1);
+        else
+            delta = static_cast<int32_t>(calibrationorigin - current);
+        if ((calibrationphase == CALIBRATION_HIGH_OUT) || (calibrationphase == CALIBRATION_LOW_OUT))
+            calibrationorigin = current;
+
+        calibrationsamples.clear();
+        sample.time    = 0.0;
+        sample.encoder = current;
+        calibrationsamples.push_back(sample);
+        DEBUGF(DBG_MOUNT, "Goto calibration phase %d: slew of %d microsteps", calibrationphase, delta);
+        clock_gettime(CLOCK_MONOTONIC, &calibrationstart);
+        if (calibrationaxis == RA_AXIS)
+            mount->SlewTo(delta, 0);
+        else
+            mount->SlewTo(0, delta);
     }
-    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
+    catch (EQModError e)
     {
-        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_DE");
-        if(number)
-            rate = number->getValue();
+        CancelCalibration(e.message);
+        e.DefaultHandleException(this);
+        return;
     }
-    else
-        return 0.0;
-    if (DEInverted)
-        rate = -rate;
-    return rate;
+    CalibrationTimer = IEAddTimer(CALIBRATION_SAMPLE_MS, (IE_TCF *)calibrationTimerCallback, this);
 }
 
-bool EQMod::gotoInProgress()
+void EQMod::calibrationTimerCallback(void *userpointer)
 {
-    return (!gotoparams.completed);
+    EQMod *p            = ((EQMod *)userpointer);
+    p->CalibrationTimer = 0;
+    p->CalibrationTimerHit();
 }
 
-bool EQMod::Goto(double r, double d)
+void EQMod::CalibrationTimerHit()
 {
-    double juliandate;
-#ifdef WITH_SCOPE_LIMITS
-    INDI::IEquatorialCoordinates gotoradec;
-    INDI::IHorizontalCoordinates gotoaltaz;
-    double gotoaz;
-    double gotoalt;
-#endif
+    struct timespec before, after;
+    CalibrationSample sample;
+    bool running, still;
+    size_t n;
 
-    if ((TrackState == SCOPE_SLEWING) || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED))
+    if (calibrationphase == CALIBRATION_IDLE)
+        return;
+    try
     {
-        LOG_WARN("Can not perform goto while goto/park in progress, or scope parked.");
-        //        EqNP.s = IPS_IDLE;
-        //        IDSetNumber(&EqNP, nullptr);
-        //        return true;
-        return false;
+        // Time the encoder read at the middle of the serial exchange
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        sample.encoder = (calibrationaxis == RA_AXIS) ? mount->GetRAEncoder() : mount->GetDEEncoder();
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        sample.time = (((before.tv_sec + after.tv_sec) / 2.0) - calibrationstart.tv_sec) +
+                      (((before.tv_nsec + after.tv_nsec) / 2.0) - calibrationstart.tv_nsec) / 1e9;
+        calibrationsamples.push_back(sample);
+        running = (calibrationaxis == RA_AXIS) ? mount->IsRARunning() : mount->IsDERunning();
+    }
+    catch (EQModError e)
+    {
+        CancelCalibration(e.message);
+        e.DefaultHandleException(this);
+        return;
     }
 
-    juliandate = getJulianDate();
-
-#ifdef WITH_SCOPE_LIMITS
-    gotoradec.rightascension  = r;
-    gotoradec.declination = d;
-    INDI::EquatorialToHorizontal(&gotoradec, &m_Location, juliandate, &gotoaltaz);
-    gotoaz  = gotoaltaz.azimuth;
-    gotoalt = gotoaltaz.altitude;
-    if (horizon)
+    n     = calibrationsamples.size();
+    still = (n > CALIBRATION_STILL) && (calibrationsamples[n - 1].encoder != calibrationsamples[0].encoder);
+    for (size_t i = 1; still && (i < CALIBRATION_STILL); i++)
+        still = (calibrationsamples[n - 1 - i].encoder == calibrationsamples[n - 1].encoder);
+    if (!still || running)
     {
-        if (!horizon->inGotoLimits(gotoaz, gotoalt))
+        if (sample.time > CALIBRATION_TIMEOUT)
         {
-            LOG_WARN("Goto outside Horizon Limits.");
-            //            EqNP.s = IPS_IDLE;
-            //            IDSetNumber(&EqNP, nullptr);
-            //            return true;
-            return false;
+            CancelCalibration("slew timed out");
+            Abort();
+            return;
         }
+        CalibrationTimer = IEAddTimer(CALIBRATION_SAMPLE_MS, (IE_TCF *)calibrationTimerCallback, this);
+        return;
     }
-#endif
 
-    LOGF_INFO("Starting Goto RA=%g DE=%g (current RA=%g DE=%g)", r, d, currentRA, currentDEC);
-    targetRA  = r;
-    targetDEC = d;
-    char RAStr[64], DecStr[64];
+    if (!AnalyzeCalibration(&calibrationresults[calibrationphase - CALIBRATION_HIGH_OUT]))
+    {
+        CancelCalibration("not enough samples at full speed");
+        return;
+    }
+    if (calibrationphase == CALIBRATION_LOW_BACK)
+    {
+        FinishCalibration();
+        return;
+    }
+    calibrationphase = static_cast<CalibrationPhase>(calibrationphase + 1);
+    StartCalibrationPhase();
+}
 
-    // Compute encoder targets and check RA limits if forced
-    bzero(&gotoparams, sizeof(gotoparams));
-    gotoparams.ratarget  = r;
-    gotoparams.detarget  = d;
-    gotoparams.racurrent = currentRA;
-    gotoparams.decurrent = currentDEC;
-    bool aligned         = false;
-#ifdef WITH_ALIGN_GEEHALEL
-    double ghratarget = r, ghdetarget = d;
-    if (AlignMethodSP.sp[0].s == ISS_ON)
+/*
+ * Fit one calibration slew: the cruise velocity is the mean of the sample velocities within 10%
+ * of the peak, the ramp-up lasts until the first of them, the ramp-down from the last of them
+ * until the encoder stops.
+ */
+bool EQMod::AnalyzeCalibration(CalibrationResult *result)
+{
+    const std::vector<CalibrationSample> &s = calibrationsamples;
+    std::vector<double> velocity;
+    double peak = 0.0, sum = 0.0, mean, tup, tdown, tstop;
+    size_t n = s.size(), count = 0, iup = 0, idown = 0, istop;
+
+    if (n < 4)
+        return false;
+    for (size_t i = 0; i + 1 < n; i++)
     {
-        aligned = true;
-        if (align)
-        {
-            align->AlignGoto(syncdata, juliandate, &m_Location, &ghratarget, &ghdetarget);
-            LOGF_INFO("Aligned Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget, ghdetarget,
-                      r, d);
-        }
-        else
-        {
-            if (syncdata.lst != 0.0)
-            {
-                ghratarget = gotoparams.ratarget - syncdata.deltaRA;
-                ghdetarget = gotoparams.detarget - syncdata.deltaDEC;
-                LOGF_INFO("Failed Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget,
-                          ghdetarget, r, d);
-            }
-        }
+        double dt = s[i + 1].time - s[i].time;
+        double dp = std::abs(static_cast<double>(static_cast<int32_t>(s[i + 1].encoder - s[i].encoder)));
+        velocity.push_back((dt > 0.0) ? (dp / dt) : 0.0);
+        peak = std::max(peak, velocity.back());
     }
-#endif
-#ifdef WITH_ALIGN
-    if (AlignMethodSP.sp[1].s == ISS_ON)
+    for (size_t i = 0; i < velocity.size(); i++)
     {
-        TelescopeDirectionVector TDV;
-        aligned = true;
-        if (!TransformCelestialToTelescope(r, d, 0.0, TDV))
+        if (velocity[i] < 0.9 * peak)
+            continue;
+        if (count == 0)
+            iup = i;
+        idown = i;
+        sum += velocity[i];
+        count++;
+    }
+    if (count < 2)
+        return false;
+    mean = sum / count;
+
+    // Interval velocities are taken at the middle of the interval
+    tup   = (s[iup].time + s[iup + 1].time) / 2.0;
+    tdown = (s[idown].time + s[idown + 1].time) / 2.0;
+    istop = n - 1;
+    while ((istop > idown + 1) && (s[istop - 1].encoder == s[n - 1].encoder))
+        istop--;
+    tstop = s[istop].time;
+
+    result->velocity   = mean;
+    result->rampup     = tup;
+    result->rampdown   = std::max(0.0, tstop - tdown);
+    result->decelsteps = std::abs(static_cast<double>(static_cast<int32_t>(s[n - 1].encoder - s[idown + 1].encoder)));
+    DEBUGF(DBG_MOUNT, "Goto calibration phase %d: %.0f microsteps/s, ramp-up %.2f s, ramp-down %.2f s over %.0f microsteps",
+           calibrationphase, result->velocity, result->rampup, result->rampdown, result->decelsteps);
+    return true;
+}
+
+// Average the outward and return slews and store them in the axis goto profile
+void EQMod::FinishCalibration()
+{
+    CalibrationResult *r = calibrationresults;
+    double highvelocity  = (r[0].velocity + r[1].velocity) / 2.0;
+    double lowvelocity   = (r[2].velocity + r[3].velocity) / 2.0;
+    double rampup        = (r[0].rampup + r[1].rampup) / 2.0;
+    double rampdown      = (r[0].rampdown + r[1].rampdown) / 2.0;
+    uint32_t finebreaks  = static_cast<uint32_t>(std::lround((r[2].decelsteps + r[3].decelsteps) / 2.0));
+    Skywatcher::MotionProfile profile;
+
+    calibrationphase = CALIBRATION_IDLE;
+    TrackState       = SCOPE_IDLE;
+    try
+    {
+        if (calibrationaxis == RA_AXIS)
         {
-            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
-                   "Failed TransformCelestialToTelescope:  RA=%lf DE=%lf, Goto RA=%lf DE=%lf", r, d, gotoparams.ratarget,
-                   gotoparams.detarget);
-            if (syncdata.lst != 0.0)
-            {
-                gotoparams.ratarget -= syncdata.deltaRA;
-                gotoparams.detarget -= syncdata.deltaDEC;
-            }
+            mount->CalibrateRAProfile(highvelocity, lowvelocity, rampup, rampdown);
+            profile            = mount->GetRAMotionProfile();
+            profile.finebreaks = finebreaks;
+            mount->SetRAMotionProfile(profile);
         }
         else
         {
-            INDI::IEquatorialCoordinates RaDec;
-            EquatorialCoordinatesFromTelescopeDirectionVector(TDV, RaDec);
-            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
-                   "TransformCelestialToTelescope: RA=%lf DE=%lf, TDV (x :%lf, y: %lf, z: %lf), local hour RA %lf DEC %lf",
-                   r, d, TDV.x, TDV.y, TDV.z, RaDec.rightascension, RaDec.declination);
-            gotoparams.ratarget = RaDec.rightascension;
-            gotoparams.detarget = RaDec.declination;
-            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
-                   "TransformCelestialToTelescope: RA=%lf DE=%lf, Goto RA=%lf DE=%lf", r, d, gotoparams.ratarget,
-                   gotoparams.detarget);
+            mount->CalibrateDEProfile(highvelocity, lowvelocity, rampup, rampdown);
+            profile            = mount->GetDEMotionProfile();
+            profile.finebreaks = finebreaks;
+            mount->SetDEMotionProfile(profile);
         }
     }
-#endif
+    catch (EQModError e)
+    {
+        CancelCalibration(e.message);
+        return;
+    }
+    UpdateMotionProfiles();
+    GotoCalibrationSP.reset();
+    GotoCalibrationSP.setState(IPS_OK);
+    GotoCalibrationSP.apply();
+    LOGF_INFO("%s goto calibration: highspeed %.0f microsteps/s (x%.3f), lowspeed %.0f microsteps/s (x%.3f), "
+              "ramp-up %.2f s, ramp-down %.2f s.", (calibrationaxis == RA_AXIS ? "RA" : "DE"), highvelocity,
+              profile.highfactor, lowvelocity, profile.lowfactor, rampup, rampdown);
+    // Breaks shorter than the natural deceleration overshoot, longer ones waste time at lowspeed
+    LOGF_INFO("%s highspeed deceleration measured over %.0f microsteps, profile breaks are %d.",
+              (calibrationaxis == RA_AXIS ? "RA" : "DE"), (r[0].decelsteps + r[1].decelsteps) / 2.0,
+              profile.highbreaks);
+    LOGF_INFO("%s lowspeed deceleration measured over %d microsteps, used as final approach breaks.",
+              (calibrationaxis == RA_AXIS ? "RA" : "DE"), finebreaks);
+}
 
-    if (!aligned && (syncdata.lst != 0.0))
+void EQMod::CancelCalibration(const char *reason)
+{
+    if (CalibrationTimer)
     {
-        gotoparams.ratarget -= syncdata.deltaRA;
-        gotoparams.detarget -= syncdata.deltaDEC;
+        IERmTimer(CalibrationTimer);
+        CalibrationTimer = 0;
     }
+    calibrationphase = CALIBRATION_IDLE;
+    TrackState       = SCOPE_IDLE;
+    GotoCalibrationSP.reset();
+    GotoCalibrationSP.setState(IPS_ALERT);
+    GotoCalibrationSP.apply();
+    LOGF_WARN("Goto calibration cancelled: %s", reason);
+}
 
-#if defined WITH_ALIGN_GEEHALEL && !defined WITH_ALIGN
-    if (aligned)
+/*
+ * Settle monitor. The aux encoders read the axes behind the gears: once the motors stop they show
+ * the ringing of the tube on top of the tracking motion, which is removed by a linear fit.
+ */
+void EQMod::StartSettle()
+{
+    if (!mount->HasAuxEncoders() || (GotoSettleSP[1].getState() != ISS_ON))
+        return;
+    StopSettle(IPS_IDLE);
+    try
     {
-        gotoparams.ratarget = ghratarget;
-        gotoparams.detarget = ghdetarget;
+        settleencodersoff = (AuxEncoderSP[1].getState() != ISS_ON);
+        if (settleencodersoff)
+        {
+            mount->TurnRAEncoder(true);
+            mount->TurnDEEncoder(true);
+        }
     }
-#endif
-#if defined WITH_ALIGN_GEEHALEL && defined WITH_ALIGN
-    if (aligned && (AlignMethodSP.sp[0].s == ISS_ON))
+    catch (EQModError e)
     {
-        LOGF_INFO("Setting Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget, ghdetarget,
-                  r, d);
-        gotoparams.ratarget = ghratarget;
-        gotoparams.detarget = ghdetarget;
+        e.DefaultHandleException(this);
+        return;
     }
-#endif
+    settling = true;
+    settlesamples.clear();
+    clock_gettime(CLOCK_MONOTONIC, &settlestart);
+    GotoSettleNP[0].setValue(0);
+    GotoSettleNP.setState(IPS_BUSY);
+    GotoSettleNP.apply();
+    SettleTimer = IEAddTimer(SETTLE_SAMPLE_MS, (IE_TCF *)settleTimerCallback, this);
+}
 
-    gotoparams.racurrentencoder = currentRAEncoder;
-    gotoparams.decurrentencoder = currentDEEncoder;
-    gotoparams.completed        = false;
-    gotoparams.checklimits      = true;
-    gotoparams.pier_side        = TargetPier;
-    gotoparams.outsidelimits    = false;
-    
-#ifdef EQMODE_EXT
-    if (Hemisphere == NORTH)
-    { 
-        int64_t delta;
-        delta = ((totalRAEncoder / 4) + (totalRAEncoder / 24)); // 7 hours 
-        gotoparams.limiteast        = mount->GetRANorthEncoder() - delta; 
-        gotoparams.limitwest        = mount->GetRANorthEncoder() + delta; 
-    }
-    else
+void EQMod::SettleTimerHit()
+{
+    struct timespec before, after;
+    SettleSample sample;
+    double threshold = GotoSettleLimitsNP[0].getValue();
+
+    if (!settling)
+        return;
+    try
     {
-        int64_t delta;
-        delta = ((totalRAEncoder / 4) + (totalRAEncoder / 24)); 
-        gotoparams.limiteast        = mount->GetRANorthEncoder() + delta; 
-        gotoparams.limitwest        = mount->GetRANorthEncoder() - delta; 
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        sample.encoder[RA_AXIS]  = mount->GetRAAuxEncoder();
+        sample.encoder[DEC_AXIS] = mount->GetDEAuxEncoder();
+        clock_gettime(CLOCK_MONOTONIC, &after);
     }
-    LOGF_INFO("Setting Eqmod Goto encoder limits to East=%d West=%d", gotoparams.limiteast, gotoparams.limitwest);
-#else
-    if (Hemisphere == NORTH)
+    catch (EQModError e)
     {
-        gotoparams.limiteast        = zeroRAEncoder - (totalRAEncoder / 4) - (totalRAEncoder / 24); // 13h
-        gotoparams.limitwest        = zeroRAEncoder + (totalRAEncoder / 4) + (totalRAEncoder / 24); // 23h
+        StopSettle(IPS_ALERT);
+        e.DefaultHandleException(this);
+        return;
     }
-    else
+    sample.time = (((before.tv_sec + after.tv_sec) / 2.0) - settlestart.tv_sec) +
+                  (((before.tv_nsec + after.tv_nsec) / 2.0) - settlestart.tv_nsec) / 1e9;
+    settlesamples.push_back(sample);
+    if (settlesamples.size() > SETTLE_WINDOW)
+        settlesamples.erase(settlesamples.begin());
+
+    if ((settlesamples.size() == SETTLE_WINDOW) && (SettleResidual(RA_AXIS) <= threshold) &&
+            (SettleResidual(DEC_AXIS) <= threshold))
     {
-        gotoparams.limiteast        = zeroRAEncoder + (totalRAEncoder / 4) + (totalRAEncoder / 24); // ??
-        gotoparams.limitwest        = zeroRAEncoder - (totalRAEncoder / 4) - (totalRAEncoder / 24); // ??
+        GotoSettleNP[0].setValue(sample.time);
+        LOGF_INFO("Mount settled %.2f s after the goto.", sample.time);
+        StopSettle(IPS_OK);
+        return;
     }
-    LOGF_INFO("Setting Eqmod Goto encoder limits to East=%d West=%d", gotoparams.limiteast, gotoparams.limitwest);
-#endif
-
-    if (gotoparams.pier_side != PIER_UNKNOWN)
+    if (sample.time > GotoSettleLimitsNP[1].getValue())
     {
-        LOG_WARN("Enforcing the pier side prevents a meridian flip and may lead to collisions of the telescope with obstacles.");
+        GotoSettleNP[0].setValue(sample.time);
+        LOGF_WARN("Mount not settled after %.0f s: residual motion RA %.1f DE %.1f aux encoder steps.", sample.time,
+                  SettleResidual(RA_AXIS), SettleResidual(DEC_AXIS));
+        StopSettle(IPS_ALERT);
+        return;
     }
+    SettleTimer = IEAddTimer(SETTLE_SAMPLE_MS, (IE_TCF *)settleTimerCallback, this);
+}
 
-    EncoderTarget(&gotoparams);
+// Largest deviation of the sampled window from a steady motion, aux encoder steps
+double EQMod::SettleResidual(int axis)
+{
+    size_t n  = settlesamples.size();
+    double st = 0.0, se = 0.0, stt = 0.0, ste = 0.0, det, slope, offset, residual = 0.0;
 
-    if (gotoparams.outsidelimits)
+    for (size_t i = 0; i < n; i++)
     {
-        LOGF_INFO("Target is unreachable, aborting (target encoders %u %u)", gotoparams.ratargetencoder,
-                  gotoparams.detargetencoder);
-        Abort();
-        return false;
+        double t = settlesamples[i].time;
+        double e = static_cast<int32_t>(settlesamples[i].encoder[axis] - settlesamples[0].encoder[axis]);
+        st += t;
+        se += e;
+        stt += t * t;
+        ste += t * e;
+    }
+    det    = n * stt - st * st;
+    slope  = (det > 0.0) ? (n * ste - st * se) / det : 0.0;
+    offset = (n > 0) ? (se - slope * st) / n : 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double e = static_cast<int32_t>(settlesamples[i].encoder[axis] - settlesamples[0].encoder[axis]);
+        residual = std::max(residual, fabs(e - (offset + slope * settlesamples[i].time)));
     }
+    return residual;
+}
 
+void EQMod::StopSettle(IPState state)
+{
+    if (!settling)
+        return;
+    if (SettleTimer)
+    {
+        IERmTimer(SettleTimer);
+        SettleTimer = 0;
+    }
+    settling = false;
     try
     {
-        // stop motor
-        mount->StopRA();
-        mount->StopDE();
-        // Start slewing
-        LOGF_INFO("Slewing mount: RA increment = %d, DE increment = %d",
-                  static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
-                  static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
-        mount->SlewTo(static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
-                      static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+        // Leave the aux encoders as they were set by the user
+        if (settleencodersoff && (AuxEncoderSP[1].getState() != ISS_ON))
+        {
+            mount->TurnRAEncoder(false);
+            mount->TurnDEEncoder(false);
+        }
     }
-    catch (EQModError &e)
+    catch (EQModError e)
     {
-        return (e.DefaultHandleException(this));
+        e.DefaultHandleException(this);
     }
+    GotoSettleNP.setState(state);
+    GotoSettleNP.apply();
+}
 
-    fs_sexa(RAStr, targetRA, 2, 3600);
-    fs_sexa(DecStr, targetDEC, 2, 3600);
-
-    // This is already set before Goto in INDI::Telescope
-    //RememberTrackState = TrackState;
-
-    TrackState         = SCOPE_SLEWING;
-
-    //EqREqNP.s = IPS_BUSY;
-    //EqNP.s = IPS_BUSY;
-
-#if 0
-    // 2017-08-01 Jasem: We should set TrackState to IPS_IDLE instead here?
-    TrackModeSP->s = IPS_IDLE;
-    IDSetSwitch(TrackModeSP, nullptr);
-#endif
-
-    LOGF_INFO("Slewing to RA: %s - DEC: %s", RAStr, DecStr);
-    return true;
+void EQMod::settleTimerCallback(void *userpointer)
+{
+    EQMod *p       = ((EQMod *)userpointer);
+    p->SettleTimer = 0;
+    p->SettleTimerHit();
 }
 
-bool EQMod::Park()
+void EQMod::SetSouthernHemisphere(bool southern)
 {
-    if (!isParked())
+    const char *hemispherenames[] = { "NORTH", "SOUTH" };
+    ISState hemispherevalues[2];
+    LOGF_DEBUG("Set southern %s", (southern ? "true" : "false"));
+    if (southern)
+        Hemisphere = SOUTH;
+    else
+        Hemisphere = NORTH;
+    RAInverted = (Hemisphere == SOUTH);
+    UpdateDEInverted();
+    if (Hemisphere == NORTH)
     {
-        if (TrackState == SCOPE_SLEWING)
-        {
-            LOG_INFO("Can not park while slewing...");
-            ParkSP.setState(IPS_ALERT);
-            ParkSP.apply();
-            return false;
+        hemispherevalues[0] = ISS_ON;
+        hemispherevalues[1] = ISS_OFF;
+        HemisphereSP.update(hemispherevalues, (char **)hemispherenames, 2);
+    }
+    else
+    {
+        hemispherevalues[0] = ISS_OFF;
+        hemispherevalues[1] = ISS_ON;
+        HemisphereSP.update(hemispherevalues, (char **)hemispherenames, 2);
+    }
+    HemisphereSP.setState(IPS_IDLE);
+    HemisphereSP.apply();
+}
+
+void EQMod::UpdateDEInverted()
+{
+    bool prev = DEInverted;
+    DEInverted = (Hemisphere == SOUTH) ^ (ReverseDECSP[0].getState() == ISS_ON);
+    if (DEInverted != prev)
+        LOGF_DEBUG("Set DEInverted %s", DEInverted ? "true" : "false");
+}
+
+void EQMod::EncoderTarget(GotoParams *g)
+{
+    double r, d;
+    double ha = 0.0;
+    double juliandate;
+    double lst;
+    double leadtime          = 0.0;
+    uint32_t targetraencoder = 0, targetdecencoder = 0;
+    bool outsidelimits = false;
+    r                  = g->ratarget;
+    d                  = g->detarget;
+
+    juliandate = getJulianDate();
+    lst        = getLst(juliandate, getLongitude());
+
+    if ((g->pier_side == PIER_UNKNOWN) && g->checklimits && PierSideOptimizerSP[1].getState() == ISS_ON)
+        g->pier_side = OptimalPierSide(g, lst);
+
+    if (g->pier_side == PIER_UNKNOWN)
+    {
+        // decide pier side and keep it consistent in iterative calls
+        ha = rangeHA(r - lst);
+        if (ha < 0.0)
+        {
+            // target WEST
+            g->pier_side = PIER_EAST;
+        }
+        else
+        {
+            g->pier_side = PIER_WEST;
+        }
+    }
+
+    targetraencoder  = EncoderFromRA(r, g->pier_side, lst, zeroRAEncoder, totalRAEncoder, Hemisphere);
+    targetdecencoder = EncoderFromDec(d, g->pier_side, zeroDEEncoder, totalDEEncoder, Hemisphere);
+
+    // Aim RA at where the target will be when the slew ends, and when the next poll notices it
+    for (int i = 0; i < GOTO_LEADTIME_ITERATIONS; i++)
+    {
+        if (g->fineapproach)
+            leadtime = std::max(mount->GetRAFineDuration(static_cast<int32_t>(targetraencoder - g->racurrentencoder)),
+                                mount->GetDEFineDuration(static_cast<int32_t>(targetdecencoder - g->decurrentencoder)));
+        else
+            leadtime = std::max(mount->GetRAGotoDuration(static_cast<int32_t>(targetraencoder - g->racurrentencoder)),
+                                mount->GetDEGotoDuration(static_cast<int32_t>(targetdecencoder - g->decurrentencoder)));
+        leadtime += getCurrentPollingPeriod() / 2000.0;
+        targetraencoder = EncoderFromRA(r, g->pier_side, getLst(juliandate + (leadtime / 86400.0), getLongitude()),
+                                        zeroRAEncoder, totalRAEncoder, Hemisphere);
+    }
+    DEBUGF(DBG_SCOPE_STATUS, "Goto lead time = %.2f s", leadtime);
+
+    if (g->checklimits)
+    {
+        if (Hemisphere == NORTH)
+        {
+            assert(g->limiteast <= g->limitwest);
+            if ((targetraencoder < g->limiteast) || (targetraencoder > g->limitwest))
+                outsidelimits = true;
+        }
+        else
+        {
+            assert(g->limiteast >= g->limitwest);
+            if ((targetraencoder > g->limiteast) || (targetraencoder < g->limitwest))
+                outsidelimits = true;
+        }
+    }
+    g->outsidelimits   = outsidelimits;
+    g->leadtime        = leadtime;
+    g->ratargetencoder = targetraencoder;
+    g->detargetencoder = targetdecencoder;
+}
+
+double EQMod::GetRATrackRate()
+{
+    double rate = 0.0;
+    ISwitch *sw;
+    sw = TrackModeSP.findOnSwitch();
+    if (!sw)
+        return 0.0;
+    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
+    {
+        rate = TRACKRATE_SIDEREAL;
+    }
+    else if (!strcmp(sw->name, "TRACK_LUNAR"))
+    {
+        rate = TRACKRATE_LUNAR;
+    }
+    else if (!strcmp(sw->name, "TRACK_SOLAR"))
+    {
+        rate = TRACKRATE_SOLAR;
+    }
+    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
+    {
+        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_RA");
+        if(number)
+            rate = number->getValue();
+    }
+    else
+        return 0.0;
+    if (RAInverted)
+        rate = -rate;
+    return rate;
+}
+
+double EQMod::GetDETrackRate()
+{
+    double rate = 0.0;
+    ISwitch *sw;
+    sw = TrackModeSP.findOnSwitch();
+    if (!sw)
+        return 0.0;
+    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_LUNAR"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_SOLAR"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
+    {
+        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_DE");
+        if(number)
+            rate = number->getValue();
+    }
+    else
+        return 0.0;
+    if (DEInverted)
+        rate = -rate;
+    return rate;
+}
+
+double EQMod::GetDefaultRATrackRate()
+{
+    double rate = 0.0;
+    auto element = TrackDefaultSP.findOnSwitch();
+    if (!element)
+        return 0.0;
+    if (element->isNameMatch("TRACK_SIDEREAL"))
+    {
+        rate = TRACKRATE_SIDEREAL;
+    }
+    else if (element->isNameMatch("TRACK_LUNAR"))
+    {
+        rate = TRACKRATE_LUNAR;
+    }
+    else if (element->isNameMatch("TRACK_SOLAR"))
+    {
+        rate = TRACKRATE_SOLAR;
+    }
+    else if (element->isNameMatch("TRACK_CUSTOM"))
+    {
+        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_RA");
+        if(number)
+            rate = number->getValue();
+    }
+    else
+        return 0.0;
+    if (RAInverted)
+        rate = -rate;
+    return rate;
+}
+
+double EQMod::GetDefaultDETrackRate()
+{
+    double rate = 0.0;
+    ISwitch *sw;
+    sw = TrackDefaultSP.findOnSwitch();
+    if (!sw)
+        return 0.0;
+    if (!strcmp(sw->name, "TRACK_SIDEREAL"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_LUNAR"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_SOLAR"))
+    {
+        rate = 0.0;
+    }
+    else if (!strcmp(sw->name, "TRACK_CUSTOM"))
+    {
+        auto number = TrackRateNP.findWidgetByName("TRACK_RATE_DE");
+        if(number)
+            rate = number->getValue();
+    }
+    else
+        return 0.0;
+    if (DEInverted)
+        rate = -rate;
+    return rate;
+}
+
+bool EQMod::gotoInProgress()
+{
+    return (!gotoparams.completed);
+}
+
+bool EQMod::Goto(double r, double d)
+{
+    if (gotoqueueactive)
+    {
+        LOG_INFO("Goto queue paused by a goto request.");
+        StopGotoQueue();
+    }
+    return StartGoto(r, d, TargetPier);
+}
+
+/*
+ * Goto planning: horizon limits, alignment, pier side and encoder targets from the current position.
+ * Nothing is sent to the mount, so plans may be computed ahead of time (see the goto queue).
+ */
+bool EQMod::PrepareGoto(double r, double d, TelescopePierSide pier, GotoParams *g)
+{
+    double juliandate;
+#ifdef WITH_SCOPE_LIMITS
+    INDI::IEquatorialCoordinates gotoradec;
+    INDI::IHorizontalCoordinates gotoaltaz;
+    double gotoaz;
+    double gotoalt;
+#endif
+
+    bzero(g, sizeof(GotoParams));
+    juliandate = getJulianDate();
+
+#ifdef WITH_SCOPE_LIMITS
+    gotoradec.rightascension  = r;
+    gotoradec.declination = d;
+    INDI::EquatorialToHorizontal(&gotoradec, &m_Location, juliandate, &gotoaltaz);
+    gotoaz  = gotoaltaz.azimuth;
+    gotoalt = gotoaltaz.altitude;
+    if (horizon)
+    {
+        if (!horizon->inGotoLimits(gotoaz, gotoalt))
+        {
+            LOG_WARN("Goto outside Horizon Limits.");
+            //            EqNP.s = IPS_IDLE;
+            //            IDSetNumber(&EqNP, nullptr);
+            //            return true;
+            return false;
+        }
+    }
+#endif
+
+    // Compute encoder targets and check RA limits if forced
+    g->ratarget  = r;
+    g->detarget  = d;
+    g->racurrent = currentRA;
+    g->decurrent = currentDEC;
+    bool aligned         = false;
+#ifdef WITH_ALIGN_GEEHALEL
+    double ghratarget = r, ghdetarget = d;
+    if (AlignMethodSP.sp[0].s == ISS_ON)
+    {
+        aligned = true;
+        if (align)
+        {
+            align->AlignGoto(syncdata, juliandate, &m_Location, &ghratarget, &ghdetarget);
+            LOGF_INFO("Aligned Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget, ghdetarget,
+                      r, d);
+        }
+        else
+        {
+            if (syncdata.lst != 0.0)
+            {
+                ghratarget = g->ratarget - syncdata.deltaRA;
+                ghdetarget = g->detarget - syncdata.deltaDEC;
+                LOGF_INFO("Failed Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget,
+                          ghdetarget, r, d);
+            }
+        }
+    }
+#endif
+#ifdef WITH_ALIGN
+    if (AlignMethodSP.sp[1].s == ISS_ON)
+    {
+        TelescopeDirectionVector TDV;
+        aligned = true;
+        if (!TransformCelestialToTelescope(r, d, 0.0, TDV))
+        {
+            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
+                   "Failed TransformCelestialToTelescope:  RA=%lf DE=%lf, Goto RA=%lf DE=%lf", r, d, g->ratarget,
+                   g->detarget);
+            if (syncdata.lst != 0.0)
+            {
+                g->ratarget -= syncdata.deltaRA;
+                g->detarget -= syncdata.deltaDEC;
+            }
+        }
+        else
+        {
+            INDI::IEquatorialCoordinates RaDec;
+            EquatorialCoordinatesFromTelescopeDirectionVector(TDV, RaDec);
+            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
+                   "TransformCelestialToTelescope: RA=%lf DE=%lf, TDV (x :%lf, y: %lf, z: %lf), local hour RA %lf DEC %lf",
+                   r, d, TDV.x, TDV.y, TDV.z, RaDec.rightascension, RaDec.declination);
+            g->ratarget = RaDec.rightascension;
+            g->detarget = RaDec.declination;
+            DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT,
+                   "TransformCelestialToTelescope: RA=%lf DE=%lf, Goto RA=%lf DE=%lf", r, d, g->ratarget,
+                   g->detarget);
+        }
+    }
+#endif
+
+    if (!aligned && (syncdata.lst != 0.0))
+    {
+        g->ratarget -= syncdata.deltaRA;
+        g->detarget -= syncdata.deltaDEC;
+    }
+
+#if defined WITH_ALIGN_GEEHALEL && !defined WITH_ALIGN
+    if (aligned)
+    {
+        g->ratarget = ghratarget;
+        g->detarget = ghdetarget;
+    }
+#endif
+#if defined WITH_ALIGN_GEEHALEL && defined WITH_ALIGN
+    if (aligned && (AlignMethodSP.sp[0].s == ISS_ON))
+    {
+        LOGF_INFO("Setting Eqmod Goto RA=%g DE=%g (target RA=%g DE=%g)", ghratarget, ghdetarget,
+                  r, d);
+        g->ratarget = ghratarget;
+        g->detarget = ghdetarget;
+    }
+#endif
+
+    g->racurrentencoder = currentRAEncoder;
+    g->decurrentencoder = currentDEEncoder;
+    g->completed        = true;
+    g->checklimits      = true;
+    g->pier_side        = pier;
+    g->outsidelimits    = false;
+
+    GetRALimits(&g->limiteast, &g->limitwest);
+    LOGF_INFO("Setting Eqmod Goto encoder limits to East=%d West=%d", g->limiteast, g->limitwest);
+
+    if (TargetPier != PIER_UNKNOWN)
+    {
+        LOG_WARN("Enforcing the pier side prevents a meridian flip and may lead to collisions of the telescope with obstacles.");
+    }
+
+    EncoderTarget(g);
+
+    if (g->outsidelimits)
+    {
+        LOGF_INFO("Target is unreachable (target encoders %u %u)", g->ratargetencoder, g->detargetencoder);
+        return false;
+    }
+    return true;
+}
+
+bool EQMod::StartGoto(double r, double d, TelescopePierSide pier)
+{
+    GotoParams plan;
+
+    if ((TrackState == SCOPE_SLEWING) || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED))
+    {
+        LOG_WARN("Can not perform goto while goto/park in progress, or scope parked.");
+        //        EqNP.s = IPS_IDLE;
+        //        IDSetNumber(&EqNP, nullptr);
+        //        return true;
+        return false;
+    }
+
+    LOGF_INFO("Starting Goto RA=%g DE=%g (current RA=%g DE=%g)", r, d, currentRA, currentDEC);
+    if (!PrepareGoto(r, d, pier, &plan))
+    {
+        if (plan.outsidelimits)
+            Abort();
+        return false;
+    }
+    return LaunchGoto(r, d, plan);
+}
+
+// Start a planned goto: stop the motors without blocking, the slew starts once both are stationary
+bool EQMod::LaunchGoto(double r, double d, const GotoParams &plan)
+{
+    char RAStr[64], DecStr[64];
+
+    StopSettle(IPS_IDLE);
+    ClearGuideOffsets();
+    StopDEStepGuide();
+    targetRA             = r;
+    targetDEC            = d;
+    gotoparams           = plan;
+    gotoparams.completed = false;
+
+    fs_sexa(RAStr, targetRA, 2, 3600);
+    fs_sexa(DecStr, targetDEC, 2, 3600);
+
+    // This is already set before Goto in INDI::Telescope
+    //RememberTrackState = TrackState;
+
+    TrackState         = SCOPE_SLEWING;
+    CancelLimitTimer();
+
+    //EqREqNP.s = IPS_BUSY;
+    //EqNP.s = IPS_BUSY;
+
+#if 0
+    // 2017-08-01 Jasem: We should set TrackState to IPS_IDLE instead here?
+    TrackModeSP->s = IPS_IDLE;
+    IDSetSwitch(TrackModeSP, nullptr);
+#endif
+
+    LOGF_INFO("Slewing to RA: %s - DEC: %s", RAStr, DecStr);
+
+    try
+    {
+        // Manual slews still decelerating must not restart tracking under the goto
+        mount->CancelPendingMotions();
+        mount->StopBothAsync([this]()
+        {
+            StartGotoSlew();
+        }, [this]()
+        {
+            GotoDropped();
+        });
+    }
+    catch (EQModError &e)
+    {
+        gotoparams.completed = true;
+        TrackState           = SCOPE_IDLE;
+        return (e.DefaultHandleException(this));
+    }
+    return true;
+}
+
+// The stops the goto was waiting for were dropped: it never starts
+void EQMod::GotoDropped()
+{
+    if ((TrackState != SCOPE_SLEWING) || gotoparams.completed)
+        return;
+    gotoparams.completed = true;
+    TrackState           = SCOPE_IDLE;
+    EqNP.setState(IPS_ALERT);
+    EqNP.apply();
+    LOG_ERROR("Goto failed: the axes could not be stopped before slewing.");
+}
+
+void EQMod::StartGotoSlew()
+{
+    if ((TrackState != SCOPE_SLEWING) || gotoparams.completed)
+        return;
+    try
+    {
+        // The axes moved while decelerating
+        currentRAEncoder            = mount->GetRAEncoder();
+        currentDEEncoder            = mount->GetDEEncoder();
+        gotoparams.racurrentencoder = currentRAEncoder;
+        gotoparams.decurrentencoder = currentDEEncoder;
+        EncoderTarget(&gotoparams);
+        if (gotoparams.outsidelimits)
+        {
+            LOGF_WARN("Target is unreachable once stopped, aborting (target encoders %u %u)", gotoparams.ratargetencoder,
+                      gotoparams.detargetencoder);
+            Abort();
+            return;
+        }
+        // Start slewing
+        LOGF_INFO("Slewing mount: RA increment = %d, DE increment = %d",
+                  static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                  static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+        mount->SlewTo(static_cast<int>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                      static_cast<int>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+        StartSlewDuration(static_cast<int32_t>(gotoparams.ratargetencoder - gotoparams.racurrentencoder),
+                          static_cast<int32_t>(gotoparams.detargetencoder - gotoparams.decurrentencoder));
+    }
+    catch (EQModError &e)
+    {
+        gotoparams.completed = true;
+        TrackState           = SCOPE_IDLE;
+        e.DefaultHandleException(this);
+    }
+}
+
+/*
+ * Goto queue. Each line (or ';' separated entry) is "RA DE [dwell]", RA in hours and DE in degrees,
+ * decimal or sexagesimal, dwell in seconds. Without a dwell time the queue waits for Next.
+ */
+bool EQMod::ParseGotoQueue(const char *text)
+{
+    std::vector<QueuedTarget> targets;
+    std::string entries(text ? text : "");
+    size_t start = 0;
+
+    for (auto &ch : entries)
+        if (ch == '\n')
+            ch = ';';
+    while (start <= entries.size())
+    {
+        size_t end = entries.find(';', start);
+        std::string entry = entries.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+        char rastr[64], destr[64];
+        QueuedTarget target;
+        int fields;
+
+        start = (end == std::string::npos) ? entries.size() + 1 : end + 1;
+        target.dwell = 0.0;
+        fields = sscanf(entry.c_str(), "%63s %63s %lf", rastr, destr, &target.dwell);
+        if (fields <= 0)
+            continue;
+        if ((fields < 2) || (f_scansexa(rastr, &target.ra) != 0) || (f_scansexa(destr, &target.dec) != 0) ||
+                (target.ra < 0.0) || (target.ra >= 24.0) || (fabs(target.dec) > 90.0) || (target.dwell < 0.0))
+        {
+            LOGF_WARN("Goto queue: invalid entry '%s'", entry.c_str());
+            return false;
+        }
+        targets.push_back(target);
+    }
+    gotoqueue      = targets;
+    gotoqueueindex = -1;
+    return true;
+}
+
+// Plan the next queued target from the current position, ahead of the Next request
+void EQMod::PlanQueuedGoto()
+{
+    size_t next = static_cast<size_t>(gotoqueueindex + 1);
+
+    gotoqueueplanned = false;
+    if (next >= gotoqueue.size())
+        return;
+    if (!PrepareGoto(gotoqueue[next].ra, gotoqueue[next].dec, TargetPier, &gotoqueueplan))
+    {
+        LOGF_WARN("Goto queue: target %d is not reachable from here.", static_cast<int>(next + 1));
+        return;
+    }
+    gotoqueueplanned = true;
+    gotoqueueplanjd  = getJulianDate();
+    DEBUGF(DBG_MOUNT, "Goto queue: target %d planned, RA increment = %d, DE increment = %d", static_cast<int>(next + 1),
+           static_cast<int32_t>(gotoqueueplan.ratargetencoder - gotoqueueplan.racurrentencoder),
+           static_cast<int32_t>(gotoqueueplan.detargetencoder - gotoqueueplan.decurrentencoder));
+}
+
+/*
+ * Slew to the next queued target using its plan. The encoder targets are only refreshed for the
+ * time elapsed since planning when the motors are stopped (see StartGotoSlew).
+ */
+bool EQMod::NextQueuedGoto()
+{
+    size_t next = static_cast<size_t>(gotoqueueindex + 1);
+
+    if (next >= gotoqueue.size())
+    {
+        LOG_WARN("Goto queue: no more targets.");
+        StopGotoQueue();
+        return false;
+    }
+    if ((TrackState == SCOPE_SLEWING) || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED))
+    {
+        LOG_WARN("Goto queue: can not start the next goto while goto/park in progress, or scope parked.");
+        return false;
+    }
+    if (GotoQueueTimer)
+    {
+        IERmTimer(GotoQueueTimer);
+        GotoQueueTimer = 0;
+    }
+    if (!gotoqueueplanned || ((getJulianDate() - gotoqueueplanjd) * 86400.0 > GOTO_QUEUE_PLAN_VALIDITY))
+        PlanQueuedGoto();
+    if (!gotoqueueplanned)
+    {
+        StopGotoQueue();
+        return false;
+    }
+
+    gotoqueueindex   = static_cast<int>(next);
+    gotoqueueplanned = false;
+    gotoqueueactive  = true;
+    RememberTrackState = TrackState;
+    UpdateGotoQueue();
+    LOGF_INFO("Goto queue: target %d/%d RA=%g DE=%g", gotoqueueindex + 1, static_cast<int>(gotoqueue.size()),
+              gotoqueue[next].ra, gotoqueue[next].dec);
+    return LaunchGoto(gotoqueue[next].ra, gotoqueue[next].dec, gotoqueueplan);
+}
+
+// Called when a goto completes: plan the following target and start the dwell time
+void EQMod::GotoQueueArrived()
+{
+    double dwell;
+
+    if (!gotoqueueactive || (gotoqueueindex < 0))
+        return;
+    dwell = gotoqueue[gotoqueueindex].dwell;
+    PlanQueuedGoto();
+    UpdateGotoQueue();
+    if (static_cast<size_t>(gotoqueueindex + 1) >= gotoqueue.size())
+    {
+        LOG_INFO("Goto queue: last target reached.");
+        gotoqueueactive = false;
+        return;
+    }
+    if (dwell > 0.0)
+    {
+        GotoQueueTimer = IEAddTimer(static_cast<int>(dwell * 1000.0), (IE_TCF *)gotoQueueTimerCallback, this);
+        LOGF_INFO("Goto queue: next target in %.0f s.", dwell);
+    }
+}
+
+void EQMod::gotoQueueTimerCallback(void *userpointer)
+{
+    EQMod *p          = ((EQMod *)userpointer);
+    p->GotoQueueTimer = 0;
+    if (!p->NextQueuedGoto())
+    {
+        p->GotoQueueSP.setState(IPS_ALERT);
+        p->GotoQueueSP.apply();
+    }
+}
+
+// Pause the queue: the current position in it is kept for the next Next request
+void EQMod::StopGotoQueue()
+{
+    if (GotoQueueTimer)
+    {
+        IERmTimer(GotoQueueTimer);
+        GotoQueueTimer = 0;
+    }
+    gotoqueueactive = false;
+    UpdateGotoQueue();
+}
+
+void EQMod::UpdateGotoQueue()
+{
+    GotoQueueNP[0].setValue(gotoqueueindex + 1);
+    GotoQueueNP[1].setValue(gotoqueue.size());
+    GotoQueueNP.setState(gotoqueueactive ? IPS_BUSY : IPS_IDLE);
+    GotoQueueNP.apply();
+}
+
+bool EQMod::Park()
+{
+    if (calibrationphase != CALIBRATION_IDLE)
+    {
+        LOG_WARN("Can not park during a goto calibration: abort it first.");
+        ParkSP.setState(IPS_ALERT);
+        ParkSP.apply();
+        return false;
+    }
+    if (!isParked())
+    {
+        if (TrackState == SCOPE_SLEWING)
+        {
+            LOG_INFO("Can not park while slewing...");
+            ParkSP.setState(IPS_ALERT);
+            ParkSP.apply();
+            return false;
+        }
+        StopSettle(IPS_IDLE);
+        ClearGuideOffsets();
+        StopDEStepGuide();
+
+        //TrackModeSP->s = IPS_IDLE;
+        //IDSetSwitch(TrackModeSP, nullptr);
+        TrackState = SCOPE_PARKING;
+        CancelLimitTimer();
+        //        ParkSP.s   = IPS_BUSY;
+        //        IDSetSwitch(&ParkSP, nullptr);
+        LOG_INFO("Mount park in progress...");
+
+        // Stop the motors without blocking, the park slew starts once both are stationary
+        try
+        {
+            mount->CancelPendingMotions();
+            mount->StopBothAsync([this]()
+            {
+                StartParkSlew();
+            }, [this]()
+            {
+                ParkDropped();
+            });
+        }
+        catch (EQModError e)
+        {
+            TrackState = SCOPE_IDLE;
+            return (e.DefaultHandleException(this));
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void EQMod::ParkDropped()
+{
+    if (TrackState != SCOPE_PARKING)
+        return;
+    TrackState = SCOPE_IDLE;
+    ParkSP.setState(IPS_ALERT);
+    ParkSP.apply();
+    LOG_ERROR("Park failed: the axes could not be stopped before slewing.");
+}
+
+void EQMod::StartParkSlew()
+{
+    if (TrackState != SCOPE_PARKING)
+        return;
+    try
+    {
+        currentRAEncoder = mount->GetRAEncoder();
+        currentDEEncoder = mount->GetDEEncoder();
+        parkRAEncoder    = GetAxis1Park();
+        parkDEEncoder    = GetAxis2Park();
+        // Start slewing
+        LOGF_INFO("Parking mount: RA increment = %d, DE increment = %d",
+                  static_cast<int32_t>(parkRAEncoder - currentRAEncoder), static_cast<int32_t>(parkDEEncoder - currentDEEncoder));
+        mount->SlewTo(static_cast<int32_t>(parkRAEncoder - currentRAEncoder),
+                      static_cast<int32_t>(parkDEEncoder - currentDEEncoder));
+        StartSlewDuration(static_cast<int32_t>(parkRAEncoder - currentRAEncoder),
+                          static_cast<int32_t>(parkDEEncoder - currentDEEncoder));
+    }
+    catch (EQModError e)
+    {
+        TrackState = SCOPE_IDLE;
+        e.DefaultHandleException(this);
+    }
+}
+
+bool EQMod::UnPark()
+{
+    SetParked(false);
+    return true;
+}
+
+bool EQMod::Sync(double ra, double dec)
+{
+    double juliandate;
+    double lst;
+    SyncData tmpsyncdata;
+    double ha;
+    TelescopePierSide pier_side;
+
+    // get current mount position asap
+    tmpsyncdata.telescopeRAEncoder  = mount->GetRAEncoder();
+    tmpsyncdata.telescopeDECEncoder = mount->GetDEEncoder();
+
+    juliandate = getJulianDate();
+    lst        = getLst(juliandate, getLongitude());
+
+    if (TrackState != SCOPE_TRACKING)
+    {
+        //        EqNP.s = IPS_ALERT;
+        //        IDSetNumber(&EqNP, nullptr);
+        LOG_WARN("Syncs are allowed only when Tracking");
+        return false;
+    }
+    /* remember the two last syncs to compute Polar alignment */
+
+    tmpsyncdata.lst       = lst;
+    tmpsyncdata.jd        = juliandate;
+    tmpsyncdata.targetRA  = ra;
+    tmpsyncdata.targetDEC = dec;
+
+    if (TargetPier == PIER_UNKNOWN)
+    {
+        ha = rangeHA(ra - lst);
+        if (ha < 0.0)
+        {
+            // target WEST
+            pier_side = PIER_EAST;
+        }
+        else
+        {
+            pier_side = PIER_WEST;
+        }
+    }
+    else
+    {
+        pier_side = TargetPier;
+    }
+    tmpsyncdata.targetRAEncoder  = EncoderFromRA(ra, pier_side, lst, zeroRAEncoder, totalRAEncoder, Hemisphere);
+    tmpsyncdata.targetDECEncoder = EncoderFromDec(dec, pier_side, zeroDEEncoder, totalDEEncoder, Hemisphere);
+
+    try
+    {
+        EncodersToRADec(tmpsyncdata.telescopeRAEncoder, tmpsyncdata.telescopeDECEncoder, lst, &tmpsyncdata.telescopeRA,
+                        &tmpsyncdata.telescopeDEC, nullptr, nullptr);
+    }
+    catch (EQModError e)
+    {
+        return (e.DefaultHandleException(this));
+    }
+
+    tmpsyncdata.deltaRA         = tmpsyncdata.targetRA - tmpsyncdata.telescopeRA;
+    tmpsyncdata.deltaDEC        = tmpsyncdata.targetDEC - tmpsyncdata.telescopeDEC;
+    tmpsyncdata.deltaRAEncoder  = static_cast<int>(tmpsyncdata.targetRAEncoder - tmpsyncdata.telescopeRAEncoder);
+    tmpsyncdata.deltaDECEncoder = static_cast<int>(tmpsyncdata.targetDECEncoder - tmpsyncdata.telescopeDECEncoder);
+#ifdef WITH_ALIGN_GEEHALEL
+    if (align && !isStandardSync())
+    {
+        align->AlignSync(syncdata, tmpsyncdata);
+        //return true;
+    }
+#endif
+#ifdef WITH_ALIGN
+    if (!isStandardSync())
+    {
+        AlignmentDatabaseEntry NewEntry;
+        INDI::IEquatorialCoordinates RaDec;
+        RaDec.rightascension  = tmpsyncdata.telescopeRA;
+        RaDec.declination = tmpsyncdata.telescopeDEC;
+        //NewEntry.ObservationJulianDate = ln_get_julian_from_sys();
+        NewEntry.ObservationJulianDate = juliandate;
+        NewEntry.RightAscension        = ra;
+        NewEntry.Declination           = dec;
+        NewEntry.TelescopeDirection    = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
+        NewEntry.PrivateDataSize       = 0;
+        DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT, "New sync point Date %lf RA %lf DEC %lf TDV(x %lf y %lf z %lf)",
+               NewEntry.ObservationJulianDate, NewEntry.RightAscension, NewEntry.Declination,
+               NewEntry.TelescopeDirection.x, NewEntry.TelescopeDirection.y, NewEntry.TelescopeDirection.z);
+        if (!CheckForDuplicateSyncPoint(NewEntry, 0.01))
+        {
+            GetAlignmentDatabase().push_back(NewEntry);
+
+            // Tell the client about size change
+            UpdateSize();
+
+            // Tell the math plugin to reinitialise
+            Initialise(this);
+
+        }
+    }
+#endif
+#if defined WITH_ALIGN_GEEHALEL || defined WITH_ALIGN
+    if (isStandardSync())
+#endif
+    {
+#ifdef WITH_ALIGN_GEEHALEL
+        if (align && isStandardSync())
+            align->AlignStandardSync(syncdata, &tmpsyncdata, &m_Location);
+#endif
+        syncdata2 = syncdata;
+        syncdata  = tmpsyncdata;
+
+        StandardSyncNP.findWidgetByName("STANDARDSYNC_RA")->setValue(syncdata.deltaRA);
+        StandardSyncNP.findWidgetByName("STANDARDSYNC_DE")->setValue(syncdata.deltaDEC);
+        StandardSyncNP.apply();
+
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_JD")->setValue(juliandate);
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_SYNCTIME")->setValue(lst);
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_CELESTIAL_RA")->setValue(syncdata.targetRA);
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_CELESTIAL_DE")->setValue(syncdata.targetDEC);
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_TELESCOPE_RA")->setValue(syncdata.telescopeRA);
+        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_TELESCOPE_DE")->setValue(syncdata.telescopeDEC);
+        StandardSyncPointNP.apply();
+
+        LOGF_INFO("Mount Synced (deltaRA = %.6f deltaDEC = %.6f)", syncdata.deltaRA, syncdata.deltaDEC);
+#ifdef WITH_SCOPE_LIMITS
+        // Aligned coordinates change: check every poll until tracking restarts
+        horizonlimitjd = 0.0;
+#endif
+        if (syncdata2.lst != 0.0)
+        {
+            computePolarAlign(syncdata2, syncdata, getLatitude(), &tpa_alt, &tpa_az);
+            SyncPolarAlignNP.findWidgetByName("SYNCPOLARALIGN_ALT")->setValue(tpa_alt);
+            SyncPolarAlignNP.findWidgetByName("SYNCPOLARALIGN_AZ")->setValue(tpa_az);
+            SyncPolarAlignNP.apply();
+            LOGF_DEBUG("computePolarAlign: Telescope Polar Axis: alt = %g, az = %g", tpa_alt, tpa_az);
+        }
+    }
+    return true;
+}
+
+IPState EQMod::GuideNorth(uint32_t ms)
+{
+    if (ms < MinPulseN->value)
+    {
+        return IPS_IDLE;
+    }
+
+    double rateshift = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_NS")->getValue();
+    LOGF_DEBUG("Timed guide North %d ms at rate %g %s", ms, rateshift, DEInverted ? "(Inverted)" : "");
+
+    if (DEInverted)
+        rateshift = -rateshift;
+    if ((GuideDEModeSP[1].getState() == ISS_ON) && (GuideBaseRate(AXIS_DE) == 0.0))
+        return StepGuideDE(rateshift, ms);
+    return StartGuidePulse(AXIS_DE, GuideBaseRate(AXIS_DE) + rateshift, ms);
+}
+
+IPState EQMod::GuideSouth(uint32_t ms)
+{
+    if (ms < MinPulseN->value)
+    {
+        return IPS_IDLE;
+    }
+
+    double rateshift = 0.0;
+    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_NS")->getValue();
+    LOGF_DEBUG("Timed guide South %d ms at rate %g %s", ms, rateshift, DEInverted ? "(Inverted)" : "");
+
+    if (DEInverted)
+        rateshift = -rateshift;
+    if ((GuideDEModeSP[1].getState() == ISS_ON) && (GuideBaseRate(AXIS_DE) == 0.0))
+        return StepGuideDE(-rateshift, ms);
+    return StartGuidePulse(AXIS_DE, GuideBaseRate(AXIS_DE) - rateshift, ms);
+}
+
+IPState EQMod::GuideEast(uint32_t ms)
+{
+    if (ms < MinPulseN->value)
+    {
+        return IPS_IDLE;
+    }
+
+    double rateshift = 0.0;
+    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_WE")->getValue();
+    LOGF_DEBUG("Timed guide East %d ms at rate %g %s", ms, rateshift, RAInverted ? "(Inverted)" : "");
+
+    if (RAInverted)
+        rateshift = -rateshift;
+    try
+    {
+        SuspendPPEC();
+    }
+    catch (EQModError e)
+    {
+        e.DefaultHandleException(this);
+        return IPS_ALERT;
+    }
+    return StartGuidePulse(AXIS_RA, GuideBaseRate(AXIS_RA) - rateshift, ms);
+}
+
+IPState EQMod::GuideWest(uint32_t ms)
+{
+    if (ms < MinPulseN->value)
+    {
+        return IPS_IDLE;
+    }
+
+    double rateshift = 0.0;
+    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_WE")->getValue();
+    LOGF_DEBUG("Timed guide West %d ms at rate %g %s", ms, rateshift, RAInverted ? "(Inverted)" : "");
+
+    if (RAInverted)
+        rateshift = -rateshift;
+    try
+    {
+        SuspendPPEC();
+    }
+    catch (EQModError e)
+    {
+        e.DefaultHandleException(this);
+        return IPS_ALERT;
+    }
+    return StartGuidePulse(AXIS_RA, GuideBaseRate(AXIS_RA) + rateshift, ms);
+}
+
+/*
+ * Guide pulses of any length, run by the guide thread from one time-ordered event queue holding
+ * the starts and restores of both axes. Events due together are run as a batch: the status checks
+ * first, then the period commands back to back, so that simultaneous RA and DE pulses start within
+ * one round trip. Starts and restores needing more than a period change (stopped axis, reversal) are
+ * left to the event loop, as they may take up backlash with its timers. A new pulse on an axis is merged with the
+ * one in progress (see MergeGuidePulse). The pulse lasts from the controller getting the guide period to it getting the
+ * tracking period: the restore is started ahead of the deadline by its measured latency.
+ */
+static std::chrono::steady_clock::duration GuideSeconds(double seconds)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+IPState EQMod::StartGuidePulse(INDI_EQ_AXIS axis, double rate, uint32_t ms)
+{
+    double restorerate = GuideBaseRate(axis);
+    bool merged = false, cancelled = false;
+    GuideStats stats;
+    GuideEvent event;
+
+    if (!StartGuideThread())
+        return IPS_ALERT;
+    ResetDither(axis);
+    {
+        std::lock_guard<std::mutex> lock(GuideMutex);
+        guidestats.pulses++;
+        if (guidepulses[axis].active && (guidepulses[axis].restorerate == restorerate))
+            merged = MergeGuidePulse(axis, rate, ms, &cancelled);
+        if (!merged)
+        {
+            DropGuideEvents(axis);
+            guidepulses[axis].active        = true;
+            guidepulses[axis].starting      = false;
+            guidepulses[axis].rate          = rate;
+            guidepulses[axis].restorerate   = restorerate;
+            guidepulses[axis].requested     = ms;
+            guidepulses[axis].achieved      = -1.0;
+            guidepulses[axis].start         = std::chrono::steady_clock::time_point();
+            guidepulses[axis].restored      = std::chrono::steady_clock::time_point();
+            guidepulses[axis].merges        = 0;
+            guidepulses[axis].encoderbefore = (axis == AXIS_DE) ? currentDEEncoder : currentRAEncoder;
+            guidepulses[axis].ppec          = GuidePPECState();
+            event.axis                      = axis;
+            event.restore                   = false;
+            // Leave the guider time to send the pulse of the other axis
+            guideevents.emplace(std::chrono::steady_clock::now() + GuideSeconds(GUIDE_BATCH_WINDOW), event);
         }
+        stats = guidestats;
+    }
+    GuideCondition.notify_one();
+    UpdateGuideStats(stats);
+    if (cancelled)
+    {
+        pulseInProgress &= (axis == AXIS_DE) ? ~1 : ~2;
+        return IPS_OK;
+    }
+    pulseInProgress |= (axis == AXIS_DE) ? 1 : 2;
+    return IPS_BUSY;
+}
+
+/*
+ * GuideMutex held. The new pulse and what remains of the one in progress are netted as a
+ * displacement: same direction pulses extend the deadline, opposite ones shorten it or reverse the
+ * pulse for the difference, and a pulse not started yet only has its rate and length changed.
+ * Returns false when the pulse in progress can not be merged.
+ */
+bool EQMod::MergeGuidePulse(INDI_EQ_AXIS axis, double rate, uint32_t ms, bool *cancelled)
+{
+    GuidePulse &pulse = guidepulses[axis];
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double oldshift = pulse.rate - pulse.restorerate;
+    double newshift = rate - pulse.restorerate;
+    double lead     = GuideRestoreLead(axis);
+    double remaining, displacement, left;
+    auto restore = guideevents.end();
+    bool pending = pulse.starting;
+    GuideEvent event;
+
+    for (auto it = guideevents.begin(); it != guideevents.end(); ++it)
+    {
+        if (it->second.axis != axis)
+            continue;
+        if (it->second.restore)
+            restore = it;
+        else
+            pending = true;
+    }
+    if ((oldshift == 0.0) || (newshift == 0.0) || (!pending && (restore == guideevents.end())))
+        return false;
+
+    if (pending)
+        remaining = pulse.requested / 1000.0;
+    else
+        remaining = std::max(0.0, std::chrono::duration<double>(restore->first - now).count() + lead);
+    displacement = oldshift * remaining + newshift * (ms / 1000.0);
+    *cancelled   = false;
+    event.axis   = axis;
 
-        try
+    if (fabs(displacement) < fabs(oldshift) * 0.001)
+    {
+        // Netted out
+        if (pending)
         {
-            // stop motor
-            mount->StopRA();
-            mount->StopDE();
-            currentRAEncoder = mount->GetRAEncoder();
-            currentDEEncoder = mount->GetDEEncoder();
-            parkRAEncoder    = GetAxis1Park();
-            parkDEEncoder    = GetAxis2Park();
-            // Start slewing
-            LOGF_INFO("Parking mount: RA increment = %d, DE increment = %d",
-                      static_cast<int32_t>(parkRAEncoder - currentRAEncoder), static_cast<int32_t>(parkDEEncoder - currentDEEncoder));
-            mount->SlewTo(static_cast<int32_t>(parkRAEncoder - currentRAEncoder),
-                          static_cast<int32_t>(parkDEEncoder - currentDEEncoder));
+            DropGuideEvents(axis);
+            pulse.active = pulse.starting = false;
+            *cancelled   = true;
         }
-        catch (EQModError e)
+        else
         {
-            return (e.DefaultHandleException(this));
+            pulse.requested = static_cast<uint32_t>(std::lround(std::chrono::duration<double, std::milli>(now - pulse.start).count()));
+            guideevents.erase(restore);
+            event.restore = true;
+            guideevents.emplace(now, event);
         }
-        //TrackModeSP->s = IPS_IDLE;
-        //IDSetSwitch(TrackModeSP, nullptr);
-        TrackState = SCOPE_PARKING;
-        //        ParkSP.s   = IPS_BUSY;
-        //        IDSetSwitch(&ParkSP, nullptr);
-        LOG_INFO("Mount park in progress...");
-
-        return true;
     }
-
-    return false;
+    else if ((displacement > 0.0) == (oldshift > 0.0))
+    {
+        left = displacement / oldshift;
+        if (pending)
+            pulse.requested = static_cast<uint32_t>(std::lround(1000.0 * left));
+        else
+        {
+            pulse.requested = static_cast<uint32_t>(std::lround(std::chrono::duration<double, std::milli>(now - pulse.start).count() +
+                                                    1000.0 * left));
+            guideevents.erase(restore);
+            event.restore = true;
+            guideevents.emplace(now + GuideSeconds(left - lead), event);
+        }
+    }
+    else
+    {
+        // Reversed: the pending start sends the new rate, otherwise a new start replaces the restore
+        left            = displacement / newshift;
+        pulse.rate      = rate;
+        pulse.requested = static_cast<uint32_t>(std::lround(1000.0 * left));
+        pulse.achieved  = -1.0;
+        if (!pending)
+        {
+            guideevents.erase(restore);
+            event.restore = false;
+            guideevents.emplace(now, event);
+        }
+    }
+    guidestats.merged++;
+    pulse.merges++;
+    LOGF_DEBUG("Timed guide %s merged with the pulse in progress: %d ms left", (axis == AXIS_DE) ? "North/South" : "West/East",
+               static_cast<int>(std::lround(1000.0 * ((fabs(displacement) < fabs(oldshift) * 0.001) ? 0.0 : left))));
+    return true;
 }
 
-bool EQMod::UnPark()
+// GuideMutex held
+double EQMod::GuideRestoreLead(INDI_EQ_AXIS axis)
 {
-    SetParked(false);
-    return true;
+    return (guiderestorelead[axis] > 0.0) ? guiderestorelead[axis] : 1.5 * mount->GetRoundTripTime();
 }
 
-bool EQMod::Sync(double ra, double dec)
+// GuideMutex held
+void EQMod::ScheduleGuideRestore(INDI_EQ_AXIS axis, std::chrono::steady_clock::time_point acted)
 {
-    double juliandate;
-    double lst;
-    SyncData tmpsyncdata;
-    double ha;
-    TelescopePierSide pier_side;
+    GuideEvent event;
 
-    // get current mount position asap
-    tmpsyncdata.telescopeRAEncoder  = mount->GetRAEncoder();
-    tmpsyncdata.telescopeDECEncoder = mount->GetDEEncoder();
+    event.axis              = axis;
+    event.restore           = true;
+    guidepulses[axis].start = acted;
+    guideevents.emplace(acted + std::chrono::milliseconds(guidepulses[axis].requested) - GuideSeconds(GuideRestoreLead(axis)),
+                        event);
+}
 
-    juliandate = getJulianDate();
-    lst        = getLst(juliandate, getLongitude());
+// Rate changes saved against a start and a restore for each pulse
+void EQMod::UpdateGuideStats(const GuideStats &stats)
+{
+    GuideStatsNP[0].setValue(stats.pulses);
+    GuideStatsNP[1].setValue(stats.merged);
+    GuideStatsNP[2].setValue(stats.ratechanges);
+    GuideStatsNP[3].setValue(std::max(0.0, 2.0 * stats.pulses - stats.ratechanges));
+    GuideStatsNP.setState(IPS_IDLE);
+    GuideStatsNP.apply();
+}
 
-    if (TrackState != SCOPE_TRACKING)
+// GuideMutex held
+void EQMod::DropGuideEvents(INDI_EQ_AXIS axis)
+{
+    for (auto it = guideevents.begin(); it != guideevents.end();)
     {
-        //        EqNP.s = IPS_ALERT;
-        //        IDSetNumber(&EqNP, nullptr);
-        LOG_WARN("Syncs are allowed only when Tracking");
+        if (it->second.axis == axis)
+            it = guideevents.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool EQMod::StartGuideThread()
+{
+    if (GuideThread.joinable())
+        return true;
+    if (pipe(guidepipe) < 0)
+    {
+        LOGF_ERROR("Can not create the guide thread pipe: %s", strerror(errno));
         return false;
     }
-    /* remember the two last syncs to compute Polar alignment */
+    GuidePipeCallback = IEAddCallback(guidepipe[0], (IE_CBF *)guidePipeCallback, this);
+    guidethreadexit   = false;
+    guidestats        = GuideStats();
+    GuideThread       = std::thread(&EQMod::GuideThreadLoop, this);
+    return true;
+}
 
-    tmpsyncdata.lst       = lst;
-    tmpsyncdata.jd        = juliandate;
-    tmpsyncdata.targetRA  = ra;
-    tmpsyncdata.targetDEC = dec;
+// Pulses in progress are dropped
+void EQMod::StopGuideThread()
+{
+    if (!GuideThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(GuideMutex);
+        guidethreadexit = true;
+        for (auto &pulse : guidepulses)
+            pulse.active = pulse.ended = pulse.deferred = pulse.starting = false;
+        guideevents.clear();
+        guideerrors.clear();
+    }
+    GuideCondition.notify_one();
+    GuideThread.join();
+    IERmCallback(GuidePipeCallback);
+    close(guidepipe[0]);
+    close(guidepipe[1]);
+    pulseInProgress = 0;
+}
 
-    if (TargetPier == PIER_UNKNOWN)
+// Forget the pulses in progress, their tracking rate is not restored
+void EQMod::CancelGuidePulses()
+{
+    std::lock_guard<std::mutex> lock(GuideMutex);
+    for (auto &pulse : guidepulses)
+        pulse.active = pulse.ended = pulse.deferred = pulse.starting = false;
+    guideevents.clear();
+    pulseInProgress = 0;
+}
+
+void EQMod::GuideThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(GuideMutex);
+
+    while (!guidethreadexit)
     {
-        ha = rangeHA(ra - lst);
-        if (ha < 0.0)
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::vector<GuideEvent> due;
+
+        while (!guideevents.empty() && (guideevents.begin()->first <= now))
         {
-            // target WEST
-            pier_side = PIER_EAST;
+            due.push_back(guideevents.begin()->second);
+            guideevents.erase(guideevents.begin());
         }
+        if (!due.empty())
+            RunGuideEvents(due);
+        else if (guideevents.empty())
+            GuideCondition.wait(lock);
         else
+            GuideCondition.wait_until(lock, guideevents.begin()->first);
+    }
+}
+
+// Guide thread, GuideMutex held
+void EQMod::RunGuideEvents(const std::vector<GuideEvent> &due)
+{
+    std::chrono::steady_clock::time_point batchstart = std::chrono::steady_clock::now();
+    std::vector<uint32_t> periods(due.size(), 0);
+    std::vector<bool> lean(due.size(), false), failed(due.size(), false);
+    bool report = false;
+    char signal = 0;
+
+    // Status checks: which events are a single period command
+    for (size_t i = 0; i < due.size(); i++)
+    {
+        GuidePulse &pulse = guidepulses[due[i].axis];
+        double rate       = due[i].restore ? pulse.restorerate : pulse.rate;
+        try
         {
-            pier_side = PIER_WEST;
+            if (due[i].axis == AXIS_DE)
+                lean[i] = mount->GetDETrackingPeriod(rate, &periods[i]);
+            else
+                lean[i] = mount->GetRATrackingPeriod(rate, &periods[i]);
+        }
+        catch (EQModError e)
+        {
+            lean[i] = false;
         }
     }
-    else
+
+    // Period commands back to back
+    for (size_t i = 0; i < due.size(); i++)
     {
-        pier_side = TargetPier;
+        if (!lean[i])
+            continue;
+        try
+        {
+            if (due[i].axis == AXIS_DE)
+                mount->SetDETrackingPeriod(periods[i]);
+            else
+                mount->SetRATrackingPeriod(periods[i]);
+            guidestats.ratechanges++;
+        }
+        catch (EQModError e)
+        {
+            guideerrors.push_back(e);
+            failed[i] = true;
+        }
     }
-    tmpsyncdata.targetRAEncoder  = EncoderFromRA(ra, pier_side, lst, zeroRAEncoder, totalRAEncoder, Hemisphere);
-    tmpsyncdata.targetDECEncoder = EncoderFromDec(dec, pier_side, zeroDEEncoder, totalDEEncoder, Hemisphere);
 
-    try
+    // Everything else
+    for (size_t i = 0; i < due.size(); i++)
     {
-        EncodersToRADec(tmpsyncdata.telescopeRAEncoder, tmpsyncdata.telescopeDECEncoder, lst, &tmpsyncdata.telescopeRA,
-                        &tmpsyncdata.telescopeDEC, nullptr, nullptr);
+        INDI_EQ_AXIS axis = due[i].axis;
+        GuidePulse &pulse = guidepulses[axis];
+        std::chrono::steady_clock::time_point acted;
+
+        if (!due[i].restore)
+        {
+            if (!lean[i])
+            {
+                pulse.starting = true;
+                report         = true;
+                continue;
+            }
+            if (failed[i])
+            {
+                pulse.active = false;
+                pulse.ended  = true;
+                report       = true;
+                continue;
+            }
+            acted = (axis == AXIS_DE) ? mount->GetDEMotionCommandTime() : mount->GetRAMotionCommandTime();
+            ScheduleGuideRestore(axis, (acted < batchstart) ? batchstart : acted);
+            continue;
+        }
+
+        pulse.active = false;
+        // Anything but a period change may stop or reverse the axis, with backlash takeups and their timers:
+        // the event loop does it, outside of GuideMutex
+        if (!lean[i])
+            pulse.deferred = true;
+        acted = (axis == AXIS_DE) ? mount->GetDEMotionCommandTime() : mount->GetRAMotionCommandTime();
+        if (!pulse.deferred && !failed[i] && (acted >= batchstart))
+        {
+            double lead = std::chrono::duration<double>(acted - batchstart).count();
+            if (guiderestorelead[axis] == 0.0)
+                guiderestorelead[axis] = lead;
+            else
+                guiderestorelead[axis] += GUIDE_LEAD_SMOOTHING * (lead - guiderestorelead[axis]);
+            pulse.achieved = std::chrono::duration<double, std::milli>(acted - pulse.start).count();
+            pulse.restored = acted;
+        }
+        pulse.ended = true;
+        report      = true;
     }
-    catch (EQModError e)
+
+    if (report && (write(guidepipe[1], &signal, 1) < 0))
+        LOGF_WARN("Guide thread: can not signal the event loop: %s", strerror(errno));
+}
+
+void EQMod::guidePipeCallback(int fd, void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    char signals[16];
+
+    if (read(fd, signals, sizeof(signals)) < 0)
+        return;
+    if (p->guidebenchrunning)
     {
-        return (e.DefaultHandleException(this));
+        // Includes the serial I/O of the pulse ends and restarts and the waits on GuideMutex
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        p->GuidePulsesEnded();
+        p->guidebenchpipe.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return;
     }
+    p->GuidePulsesEnded();
+}
+
+// Event loop side of the guide thread: starts left to the event loop and ends of pulses
+void EQMod::GuidePulsesEnded()
+{
+    std::vector<EQModError> errors;
+    bool ended[2], deferred[2], active[2];
+    double restorerates[2], achieved[2];
+    uint32_t requested[2];
+    GuidePulse records[2];
+    bool started = false;
+    GuideStats stats;
 
-    tmpsyncdata.deltaRA         = tmpsyncdata.targetRA - tmpsyncdata.telescopeRA;
-    tmpsyncdata.deltaDEC        = tmpsyncdata.targetDEC - tmpsyncdata.telescopeDEC;
-    tmpsyncdata.deltaRAEncoder  = static_cast<int>(tmpsyncdata.targetRAEncoder - tmpsyncdata.telescopeRAEncoder);
-    tmpsyncdata.deltaDECEncoder = static_cast<int>(tmpsyncdata.targetDECEncoder - tmpsyncdata.telescopeDECEncoder);
-#ifdef WITH_ALIGN_GEEHALEL
-    if (align && !isStandardSync())
     {
-        align->AlignSync(syncdata, tmpsyncdata);
-        //return true;
+        std::lock_guard<std::mutex> lock(GuideMutex);
+        errors.swap(guideerrors);
+        for (int axis = AXIS_RA; axis <= AXIS_DE; axis++)
+        {
+            GuidePulse &pulse = guidepulses[axis];
+            if (pulse.starting)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), acted;
+                pulse.starting = false;
+                guidestats.ratechanges++;
+                try
+                {
+                    if (axis == AXIS_DE)
+                        mount->StartDETracking(pulse.rate);
+                    else
+                        mount->StartRATracking(pulse.rate);
+                    // No motion command when the rate is unchanged or a backlash takeup delays it
+                    acted = (axis == AXIS_DE) ? mount->GetDEMotionCommandTime() : mount->GetRAMotionCommandTime();
+                    ScheduleGuideRestore(static_cast<INDI_EQ_AXIS>(axis), (acted < start) ? start : acted);
+                    started = true;
+                }
+                catch (EQModError e)
+                {
+                    errors.push_back(e);
+                    pulse.active = false;
+                    pulse.ended  = true;
+                }
+            }
+            records[axis]      = pulse;
+            ended[axis]        = pulse.ended;
+            deferred[axis]     = pulse.deferred;
+            active[axis]       = pulse.active;
+            restorerates[axis] = pulse.restorerate;
+            requested[axis]    = pulse.requested;
+            achieved[axis]     = pulse.achieved;
+            pulse.ended        = false;
+            pulse.deferred     = false;
+            // Restored below
+            if (ended[axis] && deferred[axis] && !active[axis])
+                guidestats.ratechanges++;
+        }
+        stats = guidestats;
     }
-#endif
-#ifdef WITH_ALIGN
-    if (!isStandardSync())
+    if (started)
+        GuideCondition.notify_one();
+    UpdateGuideStats(stats);
+
+    for (int axis = AXIS_RA; axis <= AXIS_DE; axis++)
     {
-        AlignmentDatabaseEntry NewEntry;
-        INDI::IEquatorialCoordinates RaDec;
-        RaDec.rightascension  = tmpsyncdata.telescopeRA;
-        RaDec.declination = tmpsyncdata.telescopeDEC;
-        //NewEntry.ObservationJulianDate = ln_get_julian_from_sys();
-        NewEntry.ObservationJulianDate = juliandate;
-        NewEntry.RightAscension        = ra;
-        NewEntry.Declination           = dec;
-        NewEntry.TelescopeDirection    = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
-        NewEntry.PrivateDataSize       = 0;
-        DEBUGF(INDI::AlignmentSubsystem::DBG_ALIGNMENT, "New sync point Date %lf RA %lf DEC %lf TDV(x %lf y %lf z %lf)",
-               NewEntry.ObservationJulianDate, NewEntry.RightAscension, NewEntry.Declination,
-               NewEntry.TelescopeDirection.x, NewEntry.TelescopeDirection.y, NewEntry.TelescopeDirection.z);
-        if (!CheckForDuplicateSyncPoint(NewEntry, 0.01))
+        // Replaced by a new pulse: that one completes later
+        if (!ended[axis] || active[axis])
+            continue;
+        try
         {
-            GetAlignmentDatabase().push_back(NewEntry);
+            if (axis == AXIS_RA)
+            {
+                if (ppecsuspended && (PPECResumeNP[0].getValue() == 0.0))
+                    ResumePPEC();
+                if (deferred[axis])
+                    mount->StartRATracking(restorerates[axis]);
+            }
+            else if (deferred[axis])
+                mount->StartDETracking(restorerates[axis]);
+        }
+        catch (EQModError e)
+        {
+            errors.push_back(e);
+        }
+        pulseInProgress &= (axis == AXIS_DE) ? ~1 : ~2;
+        GuideComplete(static_cast<INDI_EQ_AXIS>(axis));
+        if (achieved[axis] >= 0.0)
+            LOGF_DEBUG("End Timed guide %s: requested %d ms, achieved %.1f ms", (axis == AXIS_DE) ? "North/South" : "West/East",
+                       requested[axis], achieved[axis]);
+        else
+            LOGF_DEBUG("End Timed guide %s: requested %d ms", (axis == AXIS_DE) ? "North/South" : "West/East",
+                       requested[axis]);
+        RecordGuidePulse(static_cast<INDI_EQ_AXIS>(axis), records[axis], deferred[axis] ? GUIDE_RECORD_DEFERRED : 0);
+    }
 
-            // Tell the client about size change
-            UpdateSize();
+    for (auto &e : errors)
+    {
+        if (!(e.DefaultHandleException(this)))
+        {
+            LOG_WARN("Timed guide Error: can not restart tracking");
+        }
+    }
+}
 
-            // Tell the math plugin to reinitialise
-            Initialise(this);
+/*
+ * Rate-offset guiding: the guider sets signed offsets (arcsecs/s, West and North positive like
+ * GuideWest and GuideNorth) added to the tracking rates until changed, expired or cleared by any
+ * other motion. Each change is a single period command per axis while the motors track in lowspeed.
+ */
+double EQMod::GuideBaseRate(INDI_EQ_AXIS axis)
+{
+    double offset = GuideOffsetNP[axis].getValue();
+
+    if (axis == AXIS_DE)
+        return GetDETrackRate() + (DEInverted ? -offset : offset);
+    return GetRATrackRate() + (RAInverted ? -offset : offset);
+}
+
+void EQMod::SetGuideBaseRate(INDI_EQ_AXIS axis)
+{
+    double rate = GuideBaseRate(axis);
+    uint32_t period;
 
+    {
+        std::lock_guard<std::mutex> lock(GuideMutex);
+        // A pulse in progress restores the new rate when it ends
+        if (guidepulses[axis].active)
+        {
+            guidepulses[axis].restorerate = rate;
+            return;
         }
     }
-#endif
-#if defined WITH_ALIGN_GEEHALEL || defined WITH_ALIGN
-    if (isStandardSync())
-#endif
+    if (axis == AXIS_DE)
     {
-#ifdef WITH_ALIGN_GEEHALEL
-        if (align && isStandardSync())
-            align->AlignStandardSync(syncdata, &tmpsyncdata, &m_Location);
-#endif
-        syncdata2 = syncdata;
-        syncdata  = tmpsyncdata;
+        if (mount->GetDETrackingPeriod(rate, &period))
+            mount->SetDETrackingPeriod(period);
+        else
+            mount->StartDETracking(rate);
+    }
+    else
+    {
+        if (mount->GetRATrackingPeriod(rate, &period))
+            mount->SetRATrackingPeriod(period);
+        else
+            mount->StartRATracking(rate);
+    }
+}
 
-        StandardSyncNP.findWidgetByName("STANDARDSYNC_RA")->setValue(syncdata.deltaRA);
-        StandardSyncNP.findWidgetByName("STANDARDSYNC_DE")->setValue(syncdata.deltaDEC);
-        StandardSyncNP.apply();
+bool EQMod::ApplyGuideOffsets()
+{
+    bool offset   = (GuideOffsetNP[0].getValue() != 0.0) || (GuideOffsetNP[1].getValue() != 0.0);
+    double expiry = GuideOffsetNP[2].getValue();
 
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_JD")->setValue(juliandate);
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_SYNCTIME")->setValue(lst);
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_CELESTIAL_RA")->setValue(syncdata.targetRA);
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_CELESTIAL_DE")->setValue(syncdata.targetDEC);
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_TELESCOPE_RA")->setValue(syncdata.telescopeRA);
-        StandardSyncPointNP.findWidgetByName("STANDARDSYNCPOINT_TELESCOPE_DE")->setValue(syncdata.telescopeDEC);
-        StandardSyncPointNP.apply();
+    if (GuideOffsetTimer)
+    {
+        IERmTimer(GuideOffsetTimer);
+        GuideOffsetTimer = 0;
+    }
+    // Offsets only apply to tracking: never restart motors stopped or slewing meanwhile
+    if (TrackState != SCOPE_TRACKING)
+    {
+        GuideOffsetNP.setState(IPS_IDLE);
+        GuideOffsetNP.apply();
+        return true;
+    }
+    ResetDither();
+    try
+    {
+        SetGuideBaseRate(AXIS_RA);
+        SetGuideBaseRate(AXIS_DE);
+    }
+    catch (EQModError e)
+    {
+        GuideOffsetNP.setState(IPS_ALERT);
+        GuideOffsetNP.apply();
+        return (e.DefaultHandleException(this));
+    }
+    if (offset && (expiry > 0.0))
+        GuideOffsetTimer = IEAddTimer(static_cast<int>(expiry * 1000.0), (IE_TCF *)guideOffsetTimerCallback, this);
+    GuideOffsetNP.setState(offset ? IPS_BUSY : IPS_IDLE);
+    GuideOffsetNP.apply();
+    return true;
+}
+
+// The motors are about to get other rates: no command sent
+void EQMod::ClearGuideOffsets()
+{
+    if (GuideOffsetTimer)
+    {
+        IERmTimer(GuideOffsetTimer);
+        GuideOffsetTimer = 0;
+    }
+    if ((GuideOffsetNP[0].getValue() == 0.0) && (GuideOffsetNP[1].getValue() == 0.0))
+        return;
+    GuideOffsetNP[0].setValue(0);
+    GuideOffsetNP[1].setValue(0);
+    GuideOffsetNP.setState(IPS_IDLE);
+    GuideOffsetNP.apply();
+    LOG_INFO("Guide rate offsets cleared.");
+}
+
+void EQMod::guideOffsetTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->GuideOffsetTimer = 0;
+    p->GuideOffsetsExpired();
+}
+
+void EQMod::GuideOffsetsExpired()
+{
+    LOG_INFO("Guide rate offsets expired.");
+    GuideOffsetNP[0].setValue(0);
+    GuideOffsetNP[1].setValue(0);
+    ApplyGuideOffsets();
+}
+
+/*
+ * Tracking period dithering: a tracking period is a whole number of timer ticks, so the axis runs at
+ * floor(p) for an exact period p, too fast by p / floor(p) - 1. The error accumulated against the exact
+ * rate chooses floor(p) + 1 while ahead and floor(p) while behind: the time spent at floor(p) + 1 tends
+ * to (1/floor(p) - 1/p) / (1/floor(p) - 1/(floor(p) + 1)) and a period is only sent when the choice flips.
+ * Dithering pauses while a pulse or a step guide move uses the axis, and starts over after one: its
+ * restore sends the truncated period, even when it starts and ends between two ticks.
+ */
+void EQMod::ResetDither()
+{
+    ditherperiod[AXIS_RA] = ditherperiod[AXIS_DE] = 0;
+}
 
-        LOGF_INFO("Mount Synced (deltaRA = %.6f deltaDEC = %.6f)", syncdata.deltaRA, syncdata.deltaDEC);
-        if (syncdata2.lst != 0.0)
-        {
-            computePolarAlign(syncdata2, syncdata, getLatitude(), &tpa_alt, &tpa_az);
-            SyncPolarAlignNP.findWidgetByName("SYNCPOLARALIGN_ALT")->setValue(tpa_alt);
-            SyncPolarAlignNP.findWidgetByName("SYNCPOLARALIGN_AZ")->setValue(tpa_az);
-            SyncPolarAlignNP.apply();
-            LOGF_DEBUG("computePolarAlign: Telescope Polar Axis: alt = %g, az = %g", tpa_alt, tpa_az);
-        }
-    }
-    return true;
+void EQMod::ResetDither(INDI_EQ_AXIS axis)
+{
+    ditherperiod[axis] = 0;
 }
 
-IPState EQMod::GuideNorth(uint32_t ms)
+void EQMod::DitherAxis(INDI_EQ_AXIS axis, double dt)
 {
-    if (ms < MinPulseN->value)
+    double rate  = GuideBaseRate(axis);
+    double exact = (axis == AXIS_DE) ? mount->GetDEExactPeriod(rate) : mount->GetRAExactPeriod(rate);
+    uint32_t low = static_cast<uint32_t>(exact), period, next;
+    bool busy    = (axis == AXIS_DE) && destepguiding;
+
     {
-        return IPS_IDLE;
+        std::lock_guard<std::mutex> lock(GuideMutex);
+        busy = busy || guidepulses[axis].active;
     }
+    TrackDitherNP[2 * axis].setValue((low > 0) ? 1e6 * (exact / low - 1.0) : 0.0);
+    if ((low == 0) || (exact == low) || busy)
+    {
+        ditherperiod[axis] = 0;
+        TrackDitherNP[2 * axis + 1].setValue(TrackDitherNP[2 * axis].getValue());
+        return;
+    }
+    // After a rate change or a pulse the axis runs at the truncated period
+    if ((ditherperiod[axis] != low) && (ditherperiod[axis] != low + 1))
+    {
+        ditherperiod[axis]  = low;
+        ditherphase[axis]   = 0.0;
+        ditherelapsed[axis] = 0.0;
+    }
+    else
+    {
+        ditherphase[axis]   += (exact / ditherperiod[axis] - 1.0) * dt;
+        ditherelapsed[axis] += dt;
+    }
+    next = (ditherphase[axis] > 0.0) ? low + 1 : low;
+    if (next != ditherperiod[axis])
+    {
+        // Only a period change on the running lowspeed slew, anything else waits for the next rate change
+        if (!((axis == AXIS_DE) ? mount->GetDETrackingPeriod(rate, &period) : mount->GetRATrackingPeriod(rate, &period)))
+        {
+            ditherperiod[axis] = 0;
+            return;
+        }
+        if (axis == AXIS_DE)
+            mount->SetDETrackingPeriod(next);
+        else
+            mount->SetRATrackingPeriod(next);
+        ditherperiod[axis] = next;
+    }
+    TrackDitherNP[2 * axis + 1].setValue((ditherelapsed[axis] > 0.0) ? 1e6 * ditherphase[axis] / ditherelapsed[axis] : 0.0);
+}
 
-    double rateshift = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_NS")->getValue();
-    LOGF_DEBUG("Timed guide North %d ms at rate %g %s", ms, rateshift, DEInverted ? "(Inverted)" : "");
-
-    IPState pulseState = IPS_BUSY;
+void EQMod::DitherTimerHit()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - ditherlast).count();
 
-    if (DEInverted)
-        rateshift = -rateshift;
-    try
+    ditherlast = now;
+    if (isConnected() && (TrackState == SCOPE_TRACKING))
     {
-        if (ms >= MinPulseTimerN->value)
+        try
         {
-            pulseInProgress |= 1;
-            GuideTimerNS = IEAddTimer(ms, (IE_TCF *)timedguideNSCallback, this);
-            mount->StartDETracking(GetDETrackRate() + rateshift);
+            DitherAxis(AXIS_RA, dt);
+            DitherAxis(AXIS_DE, dt);
+            TrackDitherNP.setState(IPS_BUSY);
         }
-        else
+        catch (EQModError e)
         {
-            // We should be done once the synchronous guide is complete
-            pulseState = IPS_IDLE;
-
-            struct timespec starttime, endtime;
-            clock_gettime(CLOCK_MONOTONIC, &starttime);
-            mount->StartDETracking(GetDETrackRate() + rateshift);
-            clock_gettime(CLOCK_MONOTONIC, &endtime);
-            double elapsed =
-                (endtime.tv_sec - starttime.tv_sec) * 1000.0 + ((endtime.tv_nsec - starttime.tv_nsec) / 1000000.0);
-            if (elapsed < ms)
-            {
-                uint32_t left = ms - elapsed;
-                usleep(left * 1000);
-            }
-            try
-            {
-                mount->StartDETracking(GetDETrackRate());
-            }
-            catch (EQModError e)
-            {
-                if (!(e.DefaultHandleException(this)))
-                {
-                    DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_WARNING,
-                                "Timed guide North/South Error: can not restart tracking");
-                }
-            }
-            GuideComplete(AXIS_DE);
-            DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide North/South");
+            ResetDither();
+            TrackDitherNP.setState(IPS_ALERT);
+            if (!(e.DefaultHandleException(this)))
+                LOG_WARN("Tracking period dithering failed.");
         }
     }
-    catch (EQModError e)
+    else
     {
-        e.DefaultHandleException(this);
-        return IPS_ALERT;
+        ResetDither();
+        TrackDitherNP.setState(IPS_IDLE);
     }
+    TrackDitherNP.apply();
+    DitherTimer = IEAddTimer(DITHER_TICK_MS, (IE_TCF *)ditherTimerCallback, this);
+}
 
-    return pulseState;
+void EQMod::ditherTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->DitherTimer = 0;
+    p->DitherTimerHit();
 }
 
-IPState EQMod::GuideSouth(uint32_t ms)
+/*
+ * DE step guiding: with a zero DE guide base rate a pulse is a displacement of rate x duration, done
+ * as a lowspeed relative goto of that many microsteps instead of a slew started and stopped on time.
+ * Fractions of a microstep are carried to the next pulse. Pulses received while a move runs are
+ * added up and done as one follow-up move when it completes.
+ */
+IPState EQMod::StepGuideDE(double rate, uint32_t ms)
 {
-    if (ms < MinPulseN->value)
+    destepremainder += (rate * ms / 1000.0) * totalDEEncoder / 1296000.0;
+    if (destepguiding)
     {
-        return IPS_IDLE;
+        destepqueuedms += ms;
+        LOGF_DEBUG("Step guide North/South: %.2f microsteps queued after the running move", destepremainder);
+        return IPS_OK;
     }
+    return StartDEStepMove(rate, ms);
+}
 
-    double rateshift = 0.0;
-    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_NS")->getValue();
-    LOGF_DEBUG("Timed guide South %d ms at rate %g %s", ms, rateshift, DEInverted ? "(Inverted)" : "");
-
-    IPState pulseState = IPS_BUSY;
+IPState EQMod::StartDEStepMove(double rate, uint32_t ms)
+{
+    int32_t delta = static_cast<int32_t>(destepremainder);
 
-    if (DEInverted)
-        rateshift = -rateshift;
+    destepremainder -= delta;
+    if (delta == 0)
+    {
+        LOGF_DEBUG("Step guide North/South: %.2f microsteps carried to the next pulse", destepremainder);
+        return IPS_OK;
+    }
     try
     {
-        if (ms >= MinPulseTimerN->value)
-        {
-            pulseInProgress |= 1;
-            GuideTimerNS = IEAddTimer(ms, (IE_TCF *)timedguideNSCallback, this);
-            mount->StartDETracking(GetDETrackRate() - rateshift);
-        }
-        else
-        {
-            // We should be done once the synchronous guide is complete
-            pulseState = IPS_IDLE;
-
-            struct timespec starttime, endtime;
-            clock_gettime(CLOCK_MONOTONIC, &starttime);
-            mount->StartDETracking(GetDETrackRate() - rateshift);
-            clock_gettime(CLOCK_MONOTONIC, &endtime);
-            double elapsed =
-                (endtime.tv_sec - starttime.tv_sec) * 1000.0 + ((endtime.tv_nsec - starttime.tv_nsec) / 1000000.0);
-            if (elapsed < ms)
-            {
-                uint32_t left = ms - elapsed;
-                usleep(left * 1000);
-            }
-            try
-            {
-                mount->StartDETracking(GetDETrackRate());
-            }
-            catch (EQModError e)
-            {
-                if (!(e.DefaultHandleException(this)))
-                {
-                    DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_WARNING,
-                                "Timed guide North/South Error: can not restart tracking");
-                }
-            }
-            GuideComplete(AXIS_DE);
-            DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide North/South");
-        }
+        mount->FineSlewTo(0, delta);
+        DEStepGuideTimer = IEAddTimer(std::max(GUIDE_STEP_POLL_MS, static_cast<int>(1000.0 * mount->GetDEFineDuration(delta))),
+                                      (IE_TCF *)deStepGuideTimerCallback, this);
     }
     catch (EQModError e)
     {
         e.DefaultHandleException(this);
         return IPS_ALERT;
     }
-    return pulseState;
+    ResetDither(AXIS_DE);
+    destepstart   = std::chrono::steady_clock::now();
+    destepguiding = true;
+    destepms      = ms;
+    desteprate    = rate;
+    destepencoder = currentDEEncoder;
+    pulseInProgress |= 1;
+    LOGF_DEBUG("Step guide North/South %d ms: %d microsteps", ms, delta);
+    return IPS_BUSY;
 }
 
-IPState EQMod::GuideEast(uint32_t ms)
+void EQMod::DEStepGuideTimerHit()
 {
-    if (ms < MinPulseN->value)
+    GuidePulse pulse;
+    bool running;
+
+    try
     {
-        return IPS_IDLE;
+        // A reversal first takes up backlash: the axis stops between the takeup and the move
+        running = mount->ReadDERunning() || mount->IsMotionPending();
+    }
+    catch (EQModError e)
+    {
+        StopDEStepGuide();
+        if (!(e.DefaultHandleException(this)))
+        {
+            LOG_WARN("Step guide Error: can not read DE status");
+        }
+        return;
+    }
+    if (running)
+    {
+        DEStepGuideTimer = IEAddTimer(GUIDE_STEP_POLL_MS, (IE_TCF *)deStepGuideTimerCallback, this);
+        return;
     }
+    destepguiding = false;
+    pulseInProgress &= ~1;
+    GuideComplete(AXIS_DE);
+    pulse.start         = destepstart;
+    pulse.restored      = std::chrono::steady_clock::now();
+    pulse.rate          = desteprate;
+    pulse.restorerate   = 0.0;
+    pulse.requested     = destepms;
+    pulse.achieved      = std::chrono::duration<double, std::milli>(pulse.restored - pulse.start).count();
+    pulse.merges        = 0;
+    pulse.encoderbefore = destepencoder;
+    pulse.ppec          = GuidePPECState();
+    LOGF_DEBUG("End step guide North/South: requested %d ms, moved in %.1f ms", destepms, pulse.achieved);
+    RecordGuidePulse(AXIS_DE, pulse, GUIDE_RECORD_STEPS);
+    if (destepqueuedms > 0)
+    {
+        uint32_t ms    = destepqueuedms;
+        destepqueuedms = 0;
+        // The queued pulses may have reversed the net move
+        if (StartDEStepMove(std::copysign(fabs(desteprate), destepremainder), ms) == IPS_ALERT)
+            LOG_WARN("Step guide North/South: queued move failed.");
+    }
+}
 
-    double rateshift = 0.0;
-    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_WE")->getValue();
-    LOGF_DEBUG("Timed guide East %d ms at rate %g %s", ms, rateshift, RAInverted ? "(Inverted)" : "");
+// The DE motor is stopped or gets another motion: the move is not reported as completed
+void EQMod::StopDEStepGuide()
+{
+    if (DEStepGuideTimer)
+    {
+        IERmTimer(DEStepGuideTimer);
+        DEStepGuideTimer = 0;
+    }
+    destepremainder = 0.0;
+    destepqueuedms  = 0;
+    if (!destepguiding)
+        return;
+    destepguiding = false;
+    pulseInProgress &= ~1;
+}
 
-    IPState pulseState = IPS_BUSY;
+void EQMod::deStepGuideTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->DEStepGuideTimer = 0;
+    p->DEStepGuideTimerHit();
+}
 
-    if (RAInverted)
-        rateshift = -rateshift;
+/*
+ * PPEC and guiding: the first RA pulse turns PPEC off, each RA pulse postpones turning it on again
+ * until the quiet interval elapsed without pulses. A zero interval turns it on after each pulse.
+ */
+void EQMod::SuspendPPEC()
+{
+    double quiet = PPECResumeNP[0].getValue();
+
+    if (!mount->HasPPEC())
+        return;
+    if (!ppecsuspended)
+    {
+        if (PPECSP.getState() != IPS_BUSY)
+            return;
+        LOG_INFO("Turning PPEC off while guiding.");
+        mount->TurnPPEC(false);
+        ppecsuspended = true;
+    }
+    CancelPPECResume();
+    if (quiet > 0.0)
+        PPECResumeTimer = IEAddTimer(static_cast<int>(quiet * 1000.0), (IE_TCF *)ppecResumeTimerCallback, this);
+}
+
+void EQMod::ResumePPEC()
+{
+    CancelPPECResume();
+    if (!ppecsuspended)
+        return;
+    ppecsuspended = false;
+    LOG_INFO("Turning PPEC on after guiding.");
+    mount->TurnPPEC(true);
+}
+
+void EQMod::CancelPPECResume()
+{
+    if (PPECResumeTimer)
+    {
+        IERmTimer(PPECResumeTimer);
+        PPECResumeTimer = 0;
+    }
+}
+
+void EQMod::PPECResumeTimerHit()
+{
+    // Wait for the end of the RA pulse in progress
+    if (pulseInProgress & 2)
+    {
+        PPECResumeTimer = IEAddTimer(static_cast<int>(std::max(1.0, PPECResumeNP[0].getValue()) * 1000.0),
+                                     (IE_TCF *)ppecResumeTimerCallback, this);
+        return;
+    }
     try
     {
-        if (mount->HasPPEC())
+        ResumePPEC();
+    }
+    catch (EQModError e)
+    {
+        if (!(e.DefaultHandleException(this)))
         {
-            restartguidePPEC = false;
-            if (PPECSP.getState() == IPS_BUSY)
-            {
-                restartguidePPEC = true;
-                LOG_INFO("Turning PPEC off while guiding.");
-                mount->TurnPPEC(false);
-            }
+            LOG_WARN("Guiding Error: can not turn PPEC on");
         }
-        if (ms >= MinPulseTimerN->value)
+    }
+}
+
+void EQMod::ppecResumeTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->PPECResumeTimer = 0;
+    p->PPECResumeTimerHit();
+}
+
+static int64_t GuideMicroseconds(std::chrono::steady_clock::time_point t)
+{
+    if (t == std::chrono::steady_clock::time_point())
+        return 0;
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+uint8_t EQMod::GuidePPECState()
+{
+    if (!mount->HasPPEC())
+        return 0;
+    if (ppecsuspended)
+        return 2;
+    return (PPECSP.getState() == IPS_BUSY) ? 1 : 0;
+}
+
+void EQMod::InitGuideRing(GuideRing *ring)
+{
+    memcpy(ring->magic, "EQMODGR", 8);
+    ring->version    = GUIDE_RING_VERSION;
+    ring->capacity   = GUIDE_RING_SIZE;
+    ring->recordsize = sizeof(GuideRecord);
+    ring->reserved   = 0;
+    ring->head.store(0, std::memory_order_release);
+}
+
+// Event loop only, no allocation: the record is published by the release store of the head
+void EQMod::RecordGuidePulse(INDI_EQ_AXIS axis, const GuidePulse &pulse, uint8_t flags)
+{
+    uint64_t head       = guidering->head.load(std::memory_order_relaxed);
+    GuideRecord &record = guidering->records[head % GUIDE_RING_SIZE];
+
+    record.start         = GuideMicroseconds(pulse.start);
+    record.restored      = GuideMicroseconds(pulse.restored);
+    record.rate          = pulse.rate;
+    record.restorerate   = pulse.restorerate;
+    record.achieved      = pulse.achieved;
+    record.requested     = pulse.requested;
+    record.encoderbefore = pulse.encoderbefore;
+    record.encoderafter  = (axis == AXIS_DE) ? currentDEEncoder : currentRAEncoder;
+    record.axis          = axis;
+    record.ppec          = pulse.ppec;
+    record.flags         = flags;
+    record.merges        = static_cast<uint8_t>(std::min<uint32_t>(pulse.merges, 255));
+    record.reserved      = 0;
+    guidering->head.store(head + 1, std::memory_order_release);
+}
+
+/*
+ * Telemetry modes: 0 records kept in memory only, 1 records sent as a BLOB every GUIDE_TELEMETRY_MS,
+ * 2 ring kept in a memory-mapped file. Readers of the file copy the records below the head, then
+ * check the head again: records more than GUIDE_RING_SIZE behind it may have been overwritten.
+ */
+bool EQMod::SetGuideTelemetry(int mode)
+{
+    if (GuideTelemetryTimer)
+    {
+        IERmTimer(GuideTelemetryTimer);
+        GuideTelemetryTimer = 0;
+    }
+    CloseGuideTelemetryFile();
+    if (mode == 2)
+    {
+        const char *path = GuideTelemetryTP[0].getText();
+        void *map        = MAP_FAILED;
+        int fd           = open(path, O_RDWR | O_CREAT, 0644);
+
+        if ((fd >= 0) && (ftruncate(fd, sizeof(GuideRing)) == 0))
+            map = mmap(nullptr, sizeof(GuideRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
         {
-            pulseInProgress |= 2;
-            GuideTimerWE = IEAddTimer(ms, (IE_TCF *)timedguideWECallback, this);
-            mount->StartRATracking(GetRATrackRate() - rateshift);
+            LOGF_ERROR("Guide telemetry: can not map %s: %s", path, strerror(errno));
+            if (fd >= 0)
+                close(fd);
+            return false;
         }
-        else
+        guideringfd = fd;
+        guidering   = static_cast<GuideRing *>(map);
+        // Keep the head of a ring already in the file: its readers must never see it go backwards
+        if ((memcmp(guidering->magic, "EQMODGR", 8) != 0) || (guidering->version != GUIDE_RING_VERSION) ||
+                (guidering->capacity != GUIDE_RING_SIZE) || (guidering->recordsize != sizeof(GuideRecord)))
         {
-            // We should be done once the synchronous guide is complete
-            pulseState = IPS_IDLE;
-
-            struct timespec starttime, endtime;
-            clock_gettime(CLOCK_MONOTONIC, &starttime);
-            mount->StartRATracking(GetRATrackRate() - rateshift);
-            clock_gettime(CLOCK_MONOTONIC, &endtime);
-            double elapsed =
-                (endtime.tv_sec - starttime.tv_sec) * 1000.0 + ((endtime.tv_nsec - starttime.tv_nsec) / 1000000.0);
-            if (elapsed < ms)
-            {
-                uint32_t left = ms - elapsed;
-                usleep(left * 1000);
-            }
-            try
-            {
-                if (mount->HasPPEC())
-                {
-                    if (restartguidePPEC)
-                    {
-                        restartguidePPEC = false;
-                        DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_SESSION, "Turning PPEC on after guiding.");
-                        mount->TurnPPEC(true);
-                    }
-                }
-                mount->StartRATracking(GetRATrackRate());
-            }
-            catch (EQModError e)
-            {
-                if (!(e.DefaultHandleException(this)))
-                {
-                    DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_WARNING,
-                                "Timed guide West/East Error: can not restart tracking");
-                }
-            }
-            GuideComplete(AXIS_RA);
-            DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide West/East");
+            guidering = new (map) GuideRing;
+            InitGuideRing(guidering);
         }
     }
-    catch (EQModError e)
+    guideringtail = guidering->head.load(std::memory_order_acquire);
+    if ((mode == 1) && isConnected())
+        GuideTelemetryTimer = IEAddTimer(GUIDE_TELEMETRY_MS, (IE_TCF *)guideTelemetryTimerCallback, this);
+    return true;
+}
+
+// Back to the in-memory ring
+void EQMod::CloseGuideTelemetryFile()
+{
+    if (guidering == &guideringbuffer)
+        return;
+    munmap(guidering, sizeof(GuideRing));
+    close(guideringfd);
+    guideringfd = -1;
+    guidering   = &guideringbuffer;
+}
+
+void EQMod::DrainGuideTelemetry()
+{
+    uint64_t head = guidering->head.load(std::memory_order_acquire);
+    uint32_t count;
+
+    if (head - guideringtail > GUIDE_RING_SIZE)
     {
-        e.DefaultHandleException(this);
-        return IPS_ALERT;
+        LOGF_DEBUG("Guide telemetry: %d records overwritten before being sent",
+                   static_cast<int>(head - guideringtail - GUIDE_RING_SIZE));
+        guideringtail = head - GUIDE_RING_SIZE;
     }
+    count = static_cast<uint32_t>(head - guideringtail);
+    if (count == 0)
+        return;
+    for (uint32_t i = 0; i < count; i++)
+        guidedrain[i] = guidering->records[(guideringtail + i) % GUIDE_RING_SIZE];
+    guideringtail = head;
+    GuideTelemetryBP[0].setBlob(guidedrain);
+    GuideTelemetryBP[0].setBlobLen(count * sizeof(GuideRecord));
+    GuideTelemetryBP[0].setSize(count * sizeof(GuideRecord));
+    GuideTelemetryBP.setState(IPS_OK);
+    GuideTelemetryBP.apply();
+}
 
-    return pulseState;
+void EQMod::guideTelemetryTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->DrainGuideTelemetry();
+    p->GuideTelemetryTimer = IEAddTimer(GUIDE_TELEMETRY_MS, (IE_TCF *)guideTelemetryTimerCallback, p);
 }
 
-IPState EQMod::GuideWest(uint32_t ms)
+/*
+ * Guide benchmark: random pulses through GuideNorth/South/East/West against the simulator, one at a
+ * time or one on each axis at once, with an optional link latency added to each simulated command.
+ * The achieved durations come from the telemetry ring and the command count includes the status
+ * polling during the run. The event loop is measured three ways: the time spent in the guide calls,
+ * the time spent handling the guide thread signals, and the lateness of the polling timer, which
+ * catches any other blocking.
+ */
+bool EQMod::StartGuideBenchmark()
 {
-    if (ms < MinPulseN->value)
+    if (guidebenchrunning)
+        return true;
+    if (!isSimulation())
     {
-        return IPS_IDLE;
+        LOG_WARN("Guide benchmark: only available in simulation.");
+        return false;
+    }
+    if (TrackState != SCOPE_TRACKING)
+    {
+        LOG_WARN("Guide benchmark: the mount must be tracking.");
+        return false;
     }
+    guidebenchrunning  = true;
+    guidebenchissued   = 0;
+    guidebenchtail     = guidering->head.load(std::memory_order_acquire);
+    guidebenchcommands = mount->GetCommandCount();
+    guidebenchrandom.seed(static_cast<uint32_t>(GuideBenchNP[4].getValue()));
+    guidebencherrors.clear();
+    guidebenchblocking.clear();
+    guidebenchpipe.clear();
+    guidebenchlatency.clear();
+    guidebencherrors.reserve(static_cast<size_t>(GuideBenchNP[0].getValue()));
+    guidebenchblocking.reserve(static_cast<size_t>(GuideBenchNP[0].getValue()));
+    guidebenchpipe.reserve(2 * static_cast<size_t>(GuideBenchNP[0].getValue()));
+    mount->SetSimulatedLatency(GuideBenchNP[3].getValue());
+    GuideBenchSP.setState(IPS_BUSY);
+    GuideBenchSP.apply();
+    GuideBenchResultsNP.setState(IPS_BUSY);
+    GuideBenchResultsNP.apply();
+    LOGF_INFO("Guide benchmark: %.0f pulses of %.0f to %.0f ms, link latency %.1f ms.", GuideBenchNP[0].getValue(),
+              GuideBenchNP[1].getValue(), GuideBenchNP[2].getValue(), GuideBenchNP[3].getValue());
+    ScheduleBenchmarkStep();
+    return true;
+}
 
-    double rateshift = 0.0;
-    rateshift        = TRACKRATE_SIDEREAL * GuideRateNP.findWidgetByName("GUIDE_RATE_WE")->getValue();
-    LOGF_DEBUG("Timed guide West %d ms at rate %g %s", ms, rateshift, RAInverted ? "(Inverted)" : "");
+void EQMod::ScheduleBenchmarkStep()
+{
+    guidebenchdue   = std::chrono::steady_clock::now() + std::chrono::milliseconds(GUIDE_BENCH_POLL_MS);
+    GuideBenchTimer = IEAddTimer(GUIDE_BENCH_POLL_MS, (IE_TCF *)guideBenchTimerCallback, this);
+}
 
-    IPState pulseState = IPS_BUSY;
+void EQMod::GuideBenchmarkStep()
+{
+    std::uniform_int_distribution<uint32_t> duration(static_cast<uint32_t>(GuideBenchNP[1].getValue()),
+            static_cast<uint32_t>(GuideBenchNP[2].getValue()));
+    std::uniform_int_distribution<int> direction(0, 3);
+    std::bernoulli_distribution bothaxes(0.5);
 
-    if (RAInverted)
-        rateshift = -rateshift;
-    try
+    CollectBenchmarkRecords();
+    if (pulseInProgress != 0)
     {
-        if (mount->HasPPEC())
-        {
-            restartguidePPEC = false;
-            if (PPECSP.getState() == IPS_BUSY)
-            {
-                restartguidePPEC = true;
-                LOG_INFO("Turning PPEC off while guiding.");
-                mount->TurnPPEC(false);
-            }
-        }
-        if (ms >= MinPulseTimerN->value)
-        {
-            pulseInProgress |= 2;
-            GuideTimerWE = IEAddTimer(ms, (IE_TCF *)timedguideWECallback, this);
-            mount->StartRATracking(GetRATrackRate() + rateshift);
-        }
-        else
-        {
-            // We should be done once the synchronous guide is complete
-            pulseState = IPS_IDLE;
+        ScheduleBenchmarkStep();
+        return;
+    }
+    if (guidebenchissued >= GuideBenchNP[0].getValue())
+    {
+        StopGuideBenchmark(IPS_OK);
+        return;
+    }
+    // North, South, East, West
+    int first = direction(guidebenchrandom);
+    IssueBenchmarkPulse(first, duration(guidebenchrandom));
+    if (bothaxes(guidebenchrandom) && (guidebenchissued < GuideBenchNP[0].getValue()))
+        IssueBenchmarkPulse(((first < 2) ? 2 : 0) + (direction(guidebenchrandom) & 1), duration(guidebenchrandom));
+    ScheduleBenchmarkStep();
+}
+
+void EQMod::IssueBenchmarkPulse(int direction, uint32_t ms)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    switch (direction)
+    {
+        case 0:
+            GuideNorth(ms);
+            break;
+        case 1:
+            GuideSouth(ms);
+            break;
+        case 2:
+            GuideEast(ms);
+            break;
+        default:
+            GuideWest(ms);
+            break;
+    }
+    guidebenchblocking.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    guidebenchissued++;
+}
+
+// Step guiding moves are not timed pulses and are left out of the errors
+void EQMod::CollectBenchmarkRecords()
+{
+    uint64_t head = guidering->head.load(std::memory_order_acquire);
+
+    if (head - guidebenchtail > GUIDE_RING_SIZE)
+        guidebenchtail = head - GUIDE_RING_SIZE;
+    for (; guidebenchtail < head; guidebenchtail++)
+    {
+        const GuideRecord &record = guidering->records[guidebenchtail % GUIDE_RING_SIZE];
+        if ((record.achieved >= 0.0) && !(record.flags & GUIDE_RECORD_STEPS))
+            guidebencherrors.push_back(record.achieved - record.requested);
+    }
+}
 
-            struct timespec starttime, endtime;
-            clock_gettime(CLOCK_MONOTONIC, &starttime);
-            mount->StartRATracking(GetRATrackRate() + rateshift);
-            clock_gettime(CLOCK_MONOTONIC, &endtime);
-            double elapsed =
-                (endtime.tv_sec - starttime.tv_sec) * 1000.0 + ((endtime.tv_nsec - starttime.tv_nsec) / 1000000.0);
-            if (elapsed < ms)
-            {
-                uint32_t left = ms - elapsed;
-                usleep(left * 1000);
-            }
-            try
-            {
-                if (mount->HasPPEC())
-                {
-                    if (restartguidePPEC)
-                    {
-                        restartguidePPEC = false;
-                        DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_SESSION, "Turning PPEC on after guiding.");
-                        mount->TurnPPEC(true);
-                    }
-                }
-                mount->StartRATracking(GetRATrackRate());
-            }
-            catch (EQModError e)
-            {
-                if (!(e.DefaultHandleException(this)))
-                {
-                    DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_WARNING,
-                                "Timed guide West/East Error: can not restart tracking");
-                }
-            }
-            GuideComplete(AXIS_RA);
-            DEBUGDEVICE(getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide West/East");
-        }
+void EQMod::StopGuideBenchmark(IPState state)
+{
+    std::vector<double> abserrors;
+    double mean = 0.0, variance = 0.0;
+
+    if (!guidebenchrunning)
+        return;
+    if (GuideBenchTimer)
+    {
+        IERmTimer(GuideBenchTimer);
+        GuideBenchTimer = 0;
     }
-    catch (EQModError e)
+    guidebenchrunning = false;
+    mount->SetSimulatedLatency(0.0);
+    CollectBenchmarkRecords();
+
+    for (double e : guidebencherrors)
     {
-        e.DefaultHandleException(this);
-        return IPS_ALERT;
+        mean += e;
+        abserrors.push_back(fabs(e));
+    }
+    if (!guidebencherrors.empty())
+        mean /= guidebencherrors.size();
+    for (double e : guidebencherrors)
+        variance += (e - mean) * (e - mean);
+    if (guidebencherrors.size() > 1)
+        variance /= (guidebencherrors.size() - 1);
+    std::sort(abserrors.begin(), abserrors.end());
+
+    GuideBenchResultsNP[0].setValue(guidebenchissued);
+    GuideBenchResultsNP[1].setValue(mean);
+    GuideBenchResultsNP[2].setValue(sqrt(variance));
+    GuideBenchResultsNP[3].setValue(abserrors.empty() ? 0.0 : abserrors[static_cast<size_t>(0.95 * (abserrors.size() - 1))]);
+    GuideBenchResultsNP[4].setValue(abserrors.empty() ? 0.0 : abserrors.back());
+    SetBenchmarkMeanMax(guidebenchblocking, 5);
+    SetBenchmarkMeanMax(guidebenchpipe, 7);
+    SetBenchmarkMeanMax(guidebenchlatency, 9);
+    GuideBenchResultsNP[11].setValue(guidebenchissued ? static_cast<double>(mount->GetCommandCount() - guidebenchcommands) /
+                                    guidebenchissued : 0.0);
+    GuideBenchResultsNP.setState(state);
+    GuideBenchResultsNP.apply();
+    GuideBenchSP.setState(state);
+    GuideBenchSP.apply();
+    LOGF_INFO("Guide benchmark: %d pulses, %d timed, error %.2f +/- %.2f ms (95%% within %.2f ms, max %.2f ms), "
+              "guide calls %.2f ms (max %.2f ms), pulse end handling %.2f ms (max %.2f ms), event loop latency %.2f ms "
+              "(max %.2f ms), %.2f commands per pulse.", guidebenchissued, static_cast<int>(guidebencherrors.size()),
+              GuideBenchResultsNP[1].getValue(), GuideBenchResultsNP[2].getValue(), GuideBenchResultsNP[3].getValue(),
+              GuideBenchResultsNP[4].getValue(), GuideBenchResultsNP[5].getValue(), GuideBenchResultsNP[6].getValue(),
+              GuideBenchResultsNP[7].getValue(), GuideBenchResultsNP[8].getValue(), GuideBenchResultsNP[9].getValue(),
+              GuideBenchResultsNP[10].getValue(), GuideBenchResultsNP[11].getValue());
+}
+
+void EQMod::SetBenchmarkMeanMax(const std::vector<double> &values, int index)
+{
+    double mean = 0.0, max = 0.0;
+
+    for (double v : values)
+    {
+        mean += v;
+        max = std::max(max, v);
     }
+    if (!values.empty())
+        mean /= values.size();
+    GuideBenchResultsNP[index].setValue(mean);
+    GuideBenchResultsNP[index + 1].setValue(max);
+}
 
-    return pulseState;
+void EQMod::guideBenchTimerCallback(void *userpointer)
+{
+    EQMod *p = ((EQMod *)userpointer);
+    p->GuideBenchTimer = 0;
+    // Lateness of the polling timer: how long the event loop was busy elsewhere
+    p->guidebenchlatency.push_back(
+        std::max(0.0, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p->guidebenchdue).count()));
+    p->GuideBenchmarkStep();
 }
 
 bool EQMod::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
@@ -2591,6 +5124,149 @@ bool EQMod::ISNewNumber(const char *dev, const char *name, double values[], char
             return true;
         }
 
+        if (SlewModelNP.isNameMatch(name))
+        {
+            SlewModelNP.update(values, names, n);
+            // Scales scale every duration prediction and lead time: keep them within the property bounds
+            for (auto &scale : SlewModelNP)
+            {
+                double clamped = std::min(scale.getMax(), std::max(scale.getMin(), scale.getValue()));
+                if (clamped != scale.getValue())
+                {
+                    LOGF_WARN("Slew model %s %.3f out of range, using %.3f", scale.getLabel(), scale.getValue(), clamped);
+                    scale.setValue(clamped);
+                }
+            }
+            mount->SetRAGotoScale(SlewModelNP[0].getValue());
+            mount->SetDEGotoScale(SlewModelNP[1].getValue());
+            SlewModelNP.setState(IPS_OK);
+            SlewModelNP.apply();
+            LOGF_INFO("Setting slew model scales - RA=%.3f DE=%.3f", SlewModelNP[0].getValue(),
+                      SlewModelNP[1].getValue());
+            return true;
+        }
+
+        if (MotionProfileNP.isNameMatch(name))
+        {
+            Skywatcher::MotionProfile raprofile, deprofile;
+            double mountcode = MotionProfileNP[0].getValue(), mcversion = MotionProfileNP[1].getValue();
+            for (int i = 0; i < n; i++)
+            {
+                if (strcmp(names[i], "MOUNT_CODE") == 0)
+                    mountcode = values[i];
+                else if (strcmp(names[i], "MC_VERSION") == 0)
+                    mcversion = values[i];
+            }
+            // Profiles only apply to the mount and firmware they were made for
+            if ((static_cast<uint32_t>(mountcode) != mount->GetMountCode()) ||
+                    (static_cast<uint32_t>(mcversion) != mount->GetMCVersion()))
+            {
+                LOGF_WARN("Goto profile for mount code 0x%02X firmware %06X ignored, connected mount is 0x%02X firmware %06X",
+                          static_cast<uint32_t>(mountcode), static_cast<uint32_t>(mcversion), mount->GetMountCode(),
+                          mount->GetMCVersion());
+                UpdateMotionProfiles();
+                return true;
+            }
+            MotionProfileNP.update(values, names, n);
+            raprofile.lowspeedmargin = static_cast<uint32_t>(MotionProfileNP[2].getValue());
+            raprofile.lowperiod      = static_cast<uint32_t>(MotionProfileNP[3].getValue());
+            raprofile.highperiod     = static_cast<uint32_t>(MotionProfileNP[4].getValue());
+            raprofile.lowbreaks      = static_cast<uint32_t>(MotionProfileNP[5].getValue());
+            raprofile.highbreaks     = static_cast<uint32_t>(MotionProfileNP[6].getValue());
+            deprofile.lowspeedmargin = static_cast<uint32_t>(MotionProfileNP[7].getValue());
+            deprofile.lowperiod      = static_cast<uint32_t>(MotionProfileNP[8].getValue());
+            deprofile.highperiod     = static_cast<uint32_t>(MotionProfileNP[9].getValue());
+            deprofile.lowbreaks      = static_cast<uint32_t>(MotionProfileNP[10].getValue());
+            deprofile.highbreaks     = static_cast<uint32_t>(MotionProfileNP[11].getValue());
+            raprofile.highfactor     = MotionProfileNP[12].getValue();
+            raprofile.lowfactor      = MotionProfileNP[13].getValue();
+            raprofile.rampup         = MotionProfileNP[14].getValue();
+            raprofile.rampdown       = MotionProfileNP[15].getValue();
+            deprofile.highfactor     = MotionProfileNP[16].getValue();
+            deprofile.lowfactor      = MotionProfileNP[17].getValue();
+            deprofile.rampup         = MotionProfileNP[18].getValue();
+            deprofile.rampdown       = MotionProfileNP[19].getValue();
+            raprofile.finebreaks     = static_cast<uint32_t>(MotionProfileNP[20].getValue());
+            deprofile.finebreaks     = static_cast<uint32_t>(MotionProfileNP[21].getValue());
+            mount->SetRAMotionProfile(raprofile);
+            mount->SetDEMotionProfile(deprofile);
+            UpdateMotionProfiles();
+            LOG_INFO("Goto profile updated.");
+            return true;
+        }
+
+        if (MinTrackingTimeNP.isNameMatch(name))
+        {
+            MinTrackingTimeNP.update(values, names, n);
+            MinTrackingTimeNP.setState(IPS_OK);
+            MinTrackingTimeNP.apply();
+            LOGF_INFO("Setting minimum tracking time after a goto to %.0f minutes", MinTrackingTimeNP[0].getValue());
+            return true;
+        }
+
+        if (GuideOffsetNP.isNameMatch(name))
+        {
+            if (TrackState != SCOPE_TRACKING)
+            {
+                GuideOffsetNP.setState(IPS_ALERT);
+                GuideOffsetNP.apply();
+                LOG_WARN("Guide rate offsets need the mount to be tracking.");
+                return false;
+            }
+            GuideOffsetNP.update(values, names, n);
+            if (!ApplyGuideOffsets())
+                return false;
+            LOGF_DEBUG("Guide rate offsets: RA %.3f DE %.3f arcsecs/s, expiry %.1f s", GuideOffsetNP[0].getValue(),
+                       GuideOffsetNP[1].getValue(), GuideOffsetNP[2].getValue());
+            return true;
+        }
+
+        if (PPECResumeNP.isNameMatch(name))
+        {
+            PPECResumeNP.update(values, names, n);
+            PPECResumeNP.setState(IPS_OK);
+            PPECResumeNP.apply();
+            LOGF_INFO("PPEC turned on again after %.0f s without RA guide pulses", PPECResumeNP[0].getValue());
+            return true;
+        }
+
+        if (GuideBenchNP.isNameMatch(name))
+        {
+            GuideBenchNP.update(values, names, n);
+            if (GuideBenchNP[1].getValue() > GuideBenchNP[2].getValue())
+                GuideBenchNP[2].setValue(GuideBenchNP[1].getValue());
+            GuideBenchNP.setState(IPS_OK);
+            GuideBenchNP.apply();
+            return true;
+        }
+
+        if (GotoSettleLimitsNP.isNameMatch(name))
+        {
+            GotoSettleLimitsNP.update(values, names, n);
+            GotoSettleLimitsNP.setState(IPS_OK);
+            GotoSettleLimitsNP.apply();
+            LOGF_INFO("Settle monitor: threshold %.0f aux encoder steps, timeout %.0f s",
+                      GotoSettleLimitsNP[0].getValue(), GotoSettleLimitsNP[1].getValue());
+            return true;
+        }
+
+        if (FlipMarginNP.isNameMatch(name))
+        {
+            FlipMarginNP.update(values, names, n);
+            FlipMarginNP.setState(IPS_OK);
+            FlipMarginNP.apply();
+            LOGF_INFO("Setting RA limit margin to %.0f minutes", FlipMarginNP[0].getValue());
+            try
+            {
+                ScheduleLimitTimer(LimitRARate);
+            }
+            catch (EQModError e)
+            {
+                return (e.DefaultHandleException(this));
+            }
+            return true;
+        }
+
         if (PulseLimitsNP.isNameMatch(name))
         {
             PulseLimitsNP.update(values, names, n);
@@ -2684,7 +5360,11 @@ bool EQMod::ISNewNumber(const char *dev, const char *name, double values[], char
     {
         compose = horizon->ISNewNumber(dev, name, values, names, n);
         if (compose)
+        {
+            if (isConnected())
+                PredictHorizonLimit();
             return true;
+        }
     }
 #endif
 
@@ -2736,6 +5416,162 @@ bool EQMod::ISNewSwitch(const char *dev, const char *name, ISState *states, char
             return true;
         }
 
+        if (MeridianFlipSP.isNameMatch(name))
+        {
+            MeridianFlipSP.update(states, names, n);
+            MeridianFlipSP.setState(IPS_OK);
+            MeridianFlipSP.apply();
+            LOGF_INFO("At RA limit: %s", MeridianFlipSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (GuideBenchSP.isNameMatch(name))
+        {
+            GuideBenchSP.update(states, names, n);
+            auto sw = GuideBenchSP.findOnSwitch();
+            GuideBenchSP.reset();
+            if (sw && sw->isNameMatch("BENCH_START"))
+            {
+                if (!StartGuideBenchmark())
+                {
+                    GuideBenchSP.setState(IPS_ALERT);
+                    GuideBenchSP.apply();
+                }
+            }
+            else
+            {
+                StopGuideBenchmark(IPS_IDLE);
+                GuideBenchSP.setState(IPS_IDLE);
+                GuideBenchSP.apply();
+            }
+            return true;
+        }
+
+        if (GotoQueueSP.isNameMatch(name))
+        {
+            GotoQueueSP.update(states, names, n);
+            auto sw = GotoQueueSP.findOnSwitch();
+            GotoQueueSP.reset();
+            if (sw && sw->isNameMatch("QUEUE_CLEAR"))
+            {
+                StopGotoQueue();
+                gotoqueue.clear();
+                gotoqueueindex = -1;
+                UpdateGotoQueue();
+                LOG_INFO("Goto queue cleared.");
+                GotoQueueSP.setState(IPS_IDLE);
+            }
+            else if (sw)
+                GotoQueueSP.setState(NextQueuedGoto() ? IPS_OK : IPS_ALERT);
+            GotoQueueSP.apply();
+            return true;
+        }
+
+        if (GotoCalibrationSP.isNameMatch(name))
+        {
+            GotoCalibrationSP.update(states, names, n);
+            auto sw = GotoCalibrationSP.findOnSwitch();
+            if (!sw)
+            {
+                if (calibrationphase != CALIBRATION_IDLE)
+                    Abort();
+                return true;
+            }
+            if (!StartCalibration(sw->isNameMatch("CALIBRATE_RA") ? RA_AXIS : DEC_AXIS))
+            {
+                GotoCalibrationSP.reset();
+                GotoCalibrationSP.setState(IPS_ALERT);
+                GotoCalibrationSP.apply();
+            }
+            return true;
+        }
+
+        if (EmergencyStopSP.isNameMatch(name))
+        {
+            EmergencyStopSP.update(states, names, n);
+            EmergencyStopSP.setState(IPS_OK);
+            EmergencyStopSP.apply();
+            LOGF_INFO("Abort: %s", EmergencyStopSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (GotoSettleSP.isNameMatch(name))
+        {
+            GotoSettleSP.update(states, names, n);
+            GotoSettleSP.setState(IPS_OK);
+            GotoSettleSP.apply();
+            if (GotoSettleSP[0].getState() == ISS_ON)
+                StopSettle(IPS_IDLE);
+            LOGF_INFO("Settle monitor: %s", GotoSettleSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (GuideTelemetrySP.isNameMatch(name))
+        {
+            GuideTelemetrySP.update(states, names, n);
+            if (!SetGuideTelemetry(GuideTelemetrySP.findOnSwitchIndex()))
+            {
+                GuideTelemetrySP.reset();
+                GuideTelemetrySP[0].setState(ISS_ON);
+                SetGuideTelemetry(0);
+                GuideTelemetrySP.setState(IPS_ALERT);
+                GuideTelemetrySP.apply();
+                return false;
+            }
+            GuideTelemetrySP.setState(IPS_OK);
+            GuideTelemetrySP.apply();
+            LOGF_INFO("Guide telemetry: %s", GuideTelemetrySP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (GuideDEModeSP.isNameMatch(name))
+        {
+            GuideDEModeSP.update(states, names, n);
+            GuideDEModeSP.setState(IPS_OK);
+            GuideDEModeSP.apply();
+            destepremainder = 0.0;
+            LOGF_INFO("DE guiding: %s", GuideDEModeSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (TrackDitherSP.isNameMatch(name))
+        {
+            TrackDitherSP.update(states, names, n);
+            TrackDitherSP.setState(IPS_OK);
+            TrackDitherSP.apply();
+            ResetDither();
+            if (DitherTimer)
+            {
+                IERmTimer(DitherTimer);
+                DitherTimer = 0;
+            }
+            if (TrackDitherSP[1].getState() == ISS_ON)
+            {
+                ditherlast  = std::chrono::steady_clock::now();
+                DitherTimer = IEAddTimer(DITHER_TICK_MS, (IE_TCF *)ditherTimerCallback, this);
+            }
+            LOGF_INFO("Tracking period dithering: %s", TrackDitherSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (FineApproachSP.isNameMatch(name))
+        {
+            FineApproachSP.update(states, names, n);
+            FineApproachSP.setState(IPS_OK);
+            FineApproachSP.apply();
+            LOGF_INFO("Goto iterations: %s", FineApproachSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        if (PierSideOptimizerSP.isNameMatch(name))
+        {
+            PierSideOptimizerSP.update(states, names, n);
+            PierSideOptimizerSP.setState(IPS_OK);
+            PierSideOptimizerSP.apply();
+            LOGF_INFO("Pier side choice for gotos: %s", PierSideOptimizerSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
         if (strcmp(name, "TRACKDEFAULT") == 0)
         {
             auto swbefore = TrackDefaultSP.findOnSwitch();
@@ -2926,6 +5762,8 @@ bool EQMod::ISNewSwitch(const char *dev, const char *name, ISState *states, char
             }
             if (PPECSP && PPECSP.isNameMatch(name))
             {
+                CancelPPECResume();
+                ppecsuspended = false;
                 PPECSP.update(states, names, n);
                 if (PPECSP[1].getState() == ISS_ON)
                 {
@@ -3038,7 +5876,11 @@ bool EQMod::ISNewSwitch(const char *dev, const char *name, ISState *states, char
     {
         compose = horizon->ISNewSwitch(dev, name, states, names, n);
         if (compose)
+        {
+            if (isConnected())
+                PredictHorizonLimit();
             return true;
+        }
     }
 #endif
 #ifdef WITH_ALIGN
@@ -3073,9 +5915,40 @@ bool EQMod::ISNewText(const char *dev, const char *name, char *texts[], char *na
     {
         compose = horizon->ISNewText(dev, name, texts, names, n);
         if (compose)
+        {
+            if (isConnected())
+                PredictHorizonLimit();
             return true;
+        }
     }
 #endif
+    if (dev && (strcmp(dev, getDeviceName()) == 0) && GotoQueueTP.isNameMatch(name))
+    {
+        StopGotoQueue();
+        if (!ParseGotoQueue(texts[0]))
+        {
+            GotoQueueTP.setState(IPS_ALERT);
+            GotoQueueTP.apply();
+            return true;
+        }
+        GotoQueueTP.update(texts, names, n);
+        GotoQueueTP.setState(IPS_OK);
+        GotoQueueTP.apply();
+        UpdateGotoQueue();
+        LOGF_INFO("Goto queue loaded with %d targets, use Next to start.", static_cast<int>(gotoqueue.size()));
+        if (isConnected() && (TrackState != SCOPE_SLEWING) && (TrackState != SCOPE_PARKING))
+            PlanQueuedGoto();
+        return true;
+    }
+    if (dev && (strcmp(dev, getDeviceName()) == 0) && GuideTelemetryTP.isNameMatch(name))
+    {
+        GuideTelemetryTP.update(texts, names, n);
+        GuideTelemetryTP.setState(IPS_OK);
+        if ((GuideTelemetrySP[2].getState() == ISS_ON) && !SetGuideTelemetry(2))
+            GuideTelemetryTP.setState(IPS_ALERT);
+        GuideTelemetryTP.apply();
+        return true;
+    }
 #ifdef WITH_ALIGN
     ProcessAlignmentTextProperties(this, name, texts, names, n);
 #endif
@@ -3158,33 +6031,48 @@ bool EQMod::MoveNS(INDI_DIR_NS dir, TelescopeMotionCommand command)
         switch (command)
         {
             case MOTION_START:
-                if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED))
+                if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED) ||
+                        (calibrationphase != CALIBRATION_IDLE))
                 {
-                    LOG_WARN("Can not slew while goto/park in progress, or scope parked.");
+                    LOG_WARN("Can not slew while goto/park/calibration in progress, or scope parked.");
                     return false;
                 }
 
                 LOGF_INFO("Starting %s slew.", dirStr);
+                ClearGuideOffsets();
                 if (DEInverted)
                     rate = -rate;
                 mount->SlewDE(rate);
+#ifdef WITH_SCOPE_LIMITS
+                horizonlimitjd = 0.0;
+#endif
                 //TrackState = SCOPE_SLEWING;
                 break;
 
             case MOTION_STOP:
                 LOGF_INFO("%s Slew stopped", dirStr);
-                mount->StopDE();
-                //if (TrackModeSP->s == IPS_BUSY)
-                if (RememberTrackState == SCOPE_TRACKING)
+                // Tracking restarts once the axis has decelerated
+                mount->StopDEAsync([this]()
                 {
-                    LOG_INFO("Restarting DE Tracking...");
-                    TrackState = SCOPE_TRACKING;
-                    mount->StartDETracking(GetDETrackRate());
-                }
-                else
-                    TrackState = SCOPE_IDLE;
+                    // A goto, park or calibration started meanwhile owns the axis
+                    if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED) ||
+                            (calibrationphase != CALIBRATION_IDLE))
+                        return;
+                    //if (TrackModeSP->s == IPS_BUSY)
+                    if (RememberTrackState == SCOPE_TRACKING)
+                    {
+                        LOG_INFO("Restarting DE Tracking...");
+                        TrackState = SCOPE_TRACKING;
+                        mount->StartDETracking(GetDETrackRate());
+                    }
+                    else
+                        TrackState = SCOPE_IDLE;
 
-                RememberTrackState = TrackState;
+                    RememberTrackState = TrackState;
+#ifdef WITH_SCOPE_LIMITS
+                    PredictHorizonLimit();
+#endif
+                });
 
                 break;
         }
@@ -3206,33 +6094,50 @@ bool EQMod::MoveWE(INDI_DIR_WE dir, TelescopeMotionCommand command)
         switch (command)
         {
             case MOTION_START:
-                if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED))
+                if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED) ||
+                        (calibrationphase != CALIBRATION_IDLE))
                 {
-                    LOG_WARN("Can not slew while goto/park in progress, or scope parked.");
+                    LOG_WARN("Can not slew while goto/park/calibration in progress, or scope parked.");
                     return false;
                 }
 
                 LOGF_INFO("Starting %s slew.", dirStr);
+                ClearGuideOffsets();
                 if (RAInverted)
                     rate = -rate;
+                CancelLimitTimer();
                 mount->SlewRA(rate);
+#ifdef WITH_SCOPE_LIMITS
+                horizonlimitjd = 0.0;
+#endif
                 //TrackState = SCOPE_SLEWING;
                 break;
 
             case MOTION_STOP:
                 LOGF_INFO("%s Slew stopped", dirStr);
-                mount->StopRA();
-                //if (TrackModeSP->s == IPS_BUSY)
-                if (RememberTrackState == SCOPE_TRACKING)
+                // Tracking restarts once the axis has decelerated
+                mount->StopRAAsync([this]()
                 {
-                    LOG_INFO("Restarting RA Tracking...");
-                    TrackState = SCOPE_TRACKING;
-                    mount->StartRATracking(GetRATrackRate());
-                }
-                else
-                    TrackState = SCOPE_IDLE;
+                    // A goto, park or calibration started meanwhile owns the axis
+                    if (gotoInProgress() || (TrackState == SCOPE_PARKING) || (TrackState == SCOPE_PARKED) ||
+                            (calibrationphase != CALIBRATION_IDLE))
+                        return;
+                    //if (TrackModeSP->s == IPS_BUSY)
+                    if (RememberTrackState == SCOPE_TRACKING)
+                    {
+                        LOG_INFO("Restarting RA Tracking...");
+                        TrackState = SCOPE_TRACKING;
+                        mount->StartRATracking(GetRATrackRate());
+                        ScheduleLimitTimer(GetRATrackRate());
+                    }
+                    else
+                        TrackState = SCOPE_IDLE;
 
-                RememberTrackState = TrackState;
+                    RememberTrackState = TrackState;
+#ifdef WITH_SCOPE_LIMITS
+                    PredictHorizonLimit();
+#endif
+                });
 
                 break;
         }
@@ -3246,26 +6151,36 @@ bool EQMod::MoveWE(INDI_DIR_WE dir, TelescopeMotionCommand command)
 
 bool EQMod::Abort()
 {
-    try
-    {
-        mount->StopRA();
-    }
-    catch (EQModError e)
+    struct timespec abortstart;
+
+    clock_gettime(CLOCK_MONOTONIC, &abortstart);
+    if (EmergencyStopSP[1].getState() == ISS_ON)
+        EmergencyStop(abortstart);
+    else
     {
-        if (!(e.DefaultHandleException(this)))
+        // Drop goto, park and tracking restarts waiting for a stop, and backlash takeups
+        try
         {
-            LOG_WARN("Abort: error while stopping RA motor");
+            mount->CancelPendingMotions();
         }
-    }
-    try
-    {
-        mount->StopDE();
-    }
-    catch (EQModError e)
-    {
-        if (!(e.DefaultHandleException(this)))
+        catch (EQModError e)
+        {
+            if (!(e.DefaultHandleException(this)))
+            {
+                LOG_WARN("Abort: error while cancelling pending motions");
+            }
+        }
+        // Then stop without waiting
+        try
         {
-            LOG_WARN("Abort: error while stopping DE motor");
+            mount->StopBothAsync(nullptr);
+        }
+        catch (EQModError e)
+        {
+            if (!(e.DefaultHandleException(this)))
+            {
+                LOG_WARN("Abort: error while stopping motors");
+            }
         }
     }
 
@@ -3285,63 +6200,55 @@ bool EQMod::Abort()
 
     TrackState = SCOPE_IDLE;
     RememberTrackState = TrackState;
+    CancelLimitTimer();
+    if (calibrationphase != CALIBRATION_IDLE)
+        CancelCalibration("aborted");
+    StopGotoQueue();
+    StopSettle(IPS_IDLE);
+    ClearGuideOffsets();
+    StopDEStepGuide();
+    StopGuideBenchmark(IPS_ALERT);
     if (gotoparams.completed == false)
         gotoparams.completed = true;
-
-    return true;
-}
-
-void EQMod::timedguideNSCallback(void *userpointer)
-{
-    EQMod *p = ((EQMod *)userpointer);
-    p->pulseInProgress &= ~1;
-
-    try
-    {
-        p->mount->StartDETracking(p->GetDETrackRate());
-    }
-    catch (EQModError e)
+    if (slewmeasuring)
     {
-        if (!(e.DefaultHandleException(p)))
-        {
-            DEBUGDEVICE(p->getDeviceName(), INDI::Logger::DBG_WARNING,
-                        "Timed guide North/South Error: can not restart tracking");
-        }
+        slewmeasuring = false;
+        SlewDurationNP.setState(IPS_IDLE);
+        SlewDurationNP.apply();
     }
-    p->GuideComplete(AXIS_DE);
-    DEBUGDEVICE(p->getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide North/South");
-    IERmTimer(p->GuideTimerNS);
+
+    return true;
 }
 
-void EQMod::timedguideWECallback(void *userpointer)
+// Instant stop of both axes before anything else, pending guide pulse ends included
+void EQMod::EmergencyStop(const struct timespec &abortstart)
 {
-    EQMod *p = ((EQMod *)userpointer);
-    p->pulseInProgress &= ~2;
+    struct timespec confirmed;
+    double acked;
 
+    CancelGuidePulses();
     try
     {
-        if (p->mount->HasPPEC())
-        {
-            if (p->restartguidePPEC)
-            {
-                p->restartguidePPEC = false;
-                DEBUGDEVICE(p->getDeviceName(), INDI::Logger::DBG_SESSION, "Turning PPEC on after guiding.");
-                p->mount->TurnPPEC(true);
-            }
-        }
-        p->mount->StartRATracking(p->GetRATrackRate());
+        acked = mount->EmergencyStop();
     }
     catch (EQModError e)
     {
-        if (!(e.DefaultHandleException(p)))
+        AbortLatencyNP.setState(IPS_ALERT);
+        AbortLatencyNP.apply();
+        if (!(e.DefaultHandleException(this)))
         {
-            DEBUGDEVICE(p->getDeviceName(), INDI::Logger::DBG_WARNING,
-                        "Timed guide West/East Error: can not restart tracking");
+            LOG_WARN("Abort: error during the emergency stop");
         }
+        return;
     }
-    p->GuideComplete(AXIS_RA);
-    DEBUGDEVICE(p->getDeviceName(), INDI::Logger::DBG_DEBUG, "End Timed guide West/East");
-    IERmTimer(p->GuideTimerWE);
+    clock_gettime(CLOCK_MONOTONIC, &confirmed);
+    AbortLatencyNP[0].setValue(acked);
+    AbortLatencyNP[1].setValue((confirmed.tv_sec - abortstart.tv_sec) * 1000.0 +
+                               (confirmed.tv_nsec - abortstart.tv_nsec) / 1e6);
+    AbortLatencyNP.setState(IPS_OK);
+    AbortLatencyNP.apply();
+    LOGF_INFO("Emergency stop: stops acknowledged after %.1f ms, confirmed after %.1f ms.", AbortLatencyNP[0].getValue(),
+              AbortLatencyNP[1].getValue());
 }
 
 void EQMod::computePolarAlign(SyncData s1, SyncData s2, double lat, double *tpaalt, double *tpaaz)
@@ -3605,6 +6512,36 @@ bool EQMod::saveConfigItems(FILE *fp)
         GuideRateNP.save(fp);
     if (PulseLimitsNP)
         PulseLimitsNP.save(fp);
+    if (SlewModelNP)
+        SlewModelNP.save(fp);
+    if (MotionProfileNP)
+        MotionProfileNP.save(fp);
+    if (PierSideOptimizerSP)
+        PierSideOptimizerSP.save(fp);
+    if (FineApproachSP)
+        FineApproachSP.save(fp);
+    if (GuideDEModeSP)
+        GuideDEModeSP.save(fp);
+    if (PPECResumeNP)
+        PPECResumeNP.save(fp);
+    if (GuideTelemetrySP)
+        GuideTelemetrySP.save(fp);
+    if (TrackDitherSP)
+        TrackDitherSP.save(fp);
+    if (GuideTelemetryTP)
+        GuideTelemetryTP.save(fp);
+    if (EmergencyStopSP)
+        EmergencyStopSP.save(fp);
+    if (GotoSettleSP)
+        GotoSettleSP.save(fp);
+    if (GotoSettleLimitsNP)
+        GotoSettleLimitsNP.save(fp);
+    if (MinTrackingTimeNP)
+        MinTrackingTimeNP.save(fp);
+    if (MeridianFlipSP)
+        MeridianFlipSP.save(fp);
+    if (FlipMarginNP)
+        FlipMarginNP.save(fp);
     if (SlewSpeedsNP)
         SlewSpeedsNP.save(fp);
     if (ReverseDECSP)
@@ -3627,10 +6564,18 @@ bool EQMod::saveConfigItems(FILE *fp)
 
 bool EQMod::SetTrackRate(double raRate, double deRate)
 {
+    if (calibrationphase != CALIBRATION_IDLE)
+    {
+        LOG_WARN("Can not change tracking during a goto calibration: abort it first.");
+        return false;
+    }
+    ClearGuideOffsets();
+    ResetDither();
     try
     {
         mount->SetRARate(raRate / SKYWATCHER_STELLAR_SPEED);
         mount->SetDERate(deRate / SKYWATCHER_STELLAR_SPEED);
+        ScheduleLimitTimer(raRate);
     }
     catch (EQModError e)
     {
@@ -3647,10 +6592,21 @@ bool EQMod::SetTrackMode(uint8_t mode)
     // GetRATrackRate..etc al already check TrackModeSP to obtain the appropiate tracking rate, so no need for mode here.
     INDI_UNUSED(mode);
 
+    if (calibrationphase != CALIBRATION_IDLE)
+    {
+        LOG_WARN("Can not change tracking during a goto calibration: abort it first.");
+        return false;
+    }
+    ClearGuideOffsets();
+    ResetDither();
     try
     {
         mount->StartRATracking(GetRATrackRate());
         mount->StartDETracking(GetDETrackRate());
+        ScheduleLimitTimer(GetRATrackRate());
+#ifdef WITH_SCOPE_LIMITS
+        PredictHorizonLimit();
+#endif
     }
     catch (EQModError e)
     {
@@ -3662,6 +6618,12 @@ bool EQMod::SetTrackMode(uint8_t mode)
 
 bool EQMod::SetTrackEnabled(bool enabled)
 {
+    if (calibrationphase != CALIBRATION_IDLE)
+    {
+        LOG_WARN("Can not change tracking during a goto calibration: abort it first.");
+        return false;
+    }
+    ResetDither();
     try
     {
         if (enabled)
@@ -3671,14 +6633,19 @@ bool EQMod::SetTrackEnabled(bool enabled)
             RememberTrackState = TrackState;
             mount->StartRATracking(GetRATrackRate());
             mount->StartDETracking(GetDETrackRate());
+            ScheduleLimitTimer(GetRATrackRate());
+#ifdef WITH_SCOPE_LIMITS
+            PredictHorizonLimit();
+#endif
         }
         else if (enabled == false)
         {
             LOGF_WARN("Stopping Tracking (%s).", TrackModeSP.findOnSwitch()->getLabel());
             TrackState     = SCOPE_IDLE;
             RememberTrackState = TrackState;
-            mount->StopRA();
-            mount->StopDE();
+            CancelLimitTimer();
+            ClearGuideOffsets();
+            mount->StopBothAsync(nullptr);
         }
     }
     catch (EQModError e)
@@ -32,6 +32,15 @@
 
 #include <libnova/ln_types.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
 typedef struct SyncData
 {
     double lst, jd;
@@ -86,9 +95,6 @@ protected:
     struct timespec lastclockupdate;
     double juliandate;
 
-    int GuideTimerNS;
-    int GuideTimerWE;
-
     // INumber *GuideRateN                        = nullptr;
     INDI::PropertyNumber   GuideRateNP         {INDI::Property()};
     INDI::PropertyText     MountInformationTP  {INDI::Property()};
@@ -135,6 +141,43 @@ protected:
     INumber *MinPulseTimerN              = nullptr;
     INDI::PropertyNumber   PulseLimitsNP       {INDI::Property()};
 
+    INDI::PropertyNumber   SlewDurationNP      {3};
+    INDI::PropertyNumber   SlewModelNP         {2};
+    INDI::PropertyNumber   MotionProfileNP     {22};
+    INDI::PropertySwitch   GotoCalibrationSP   {2};
+    INDI::PropertyText     GotoQueueTP         {1};
+    INDI::PropertySwitch   GotoQueueSP         {2};
+    INDI::PropertyNumber   GotoQueueNP         {2};
+    INDI::PropertyNumber   GotoStatsNP         {4};
+
+    INDI::PropertySwitch   PierSideOptimizerSP {2};
+    INDI::PropertySwitch   FineApproachSP      {2};
+    INDI::PropertySwitch   GotoSettleSP        {2};
+    INDI::PropertyNumber   GotoSettleLimitsNP  {2};
+    INDI::PropertyNumber   GotoSettleNP        {1};
+    INDI::PropertySwitch   EmergencyStopSP     {2};
+    INDI::PropertyNumber   AbortLatencyNP      {2};
+    INDI::PropertyNumber   GuideOffsetNP       {3};
+    INDI::PropertySwitch   GuideDEModeSP       {2};
+    INDI::PropertyNumber   GuideStatsNP        {4};
+    INDI::PropertyNumber   PPECResumeNP        {1};
+    INDI::PropertySwitch   GuideTelemetrySP    {3};
+    INDI::PropertyText     GuideTelemetryTP    {1};
+    INDI::PropertyBlob     GuideTelemetryBP    {1};
+    INDI::PropertyNumber   GuideBenchNP        {5};
+    INDI::PropertySwitch   GuideBenchSP        {2};
+    INDI::PropertyNumber   GuideBenchResultsNP {12};
+    INDI::PropertySwitch   TrackDitherSP       {2};
+    INDI::PropertyNumber   TrackDitherNP       {4};
+    INDI::PropertyNumber   MinTrackingTimeNP   {1};
+
+    INDI::PropertySwitch   MeridianFlipSP      {2};
+    INDI::PropertyNumber   FlipMarginNP        {1};
+    INDI::PropertyNumber   LimitTimeNP         {1};
+#ifdef WITH_SCOPE_LIMITS
+    INDI::PropertyNumber   HorizonLimitTimeNP  {1};
+#endif
+
     enum Hemisphere
     {
         NORTH = 0,
@@ -146,8 +189,9 @@ protected:
         double ratarget, detarget, racurrent, decurrent;
         uint32_t ratargetencoder, detargetencoder, racurrentencoder, decurrentencoder;
         uint32_t limiteast, limitwest;
-        unsigned int iterative_count;
-        bool checklimits, outsidelimits, completed;
+        double leadtime;
+        unsigned int iterative_count, fine_count;
+        bool checklimits, outsidelimits, completed, fineapproach;
         TelescopePierSide pier_side;
     } GotoParams;
 
@@ -172,14 +216,16 @@ protected:
     double EncoderFromDec(double detarget, TelescopePierSide p, uint32_t initstep, uint32_t totalstep,
                           enum Hemisphere h);
     void EncoderTarget(GotoParams *g);
+    TelescopePierSide OptimalPierSide(GotoParams *g, double lst);
+    double RALimitTime(uint32_t raencoder, uint32_t limiteast, uint32_t limitwest, double rarate);
+    void GetRALimits(uint32_t *limiteast, uint32_t *limitwest);
+    bool StartGoto(double r, double d, TelescopePierSide pier);
     void SetSouthernHemisphere(bool southern);
     void UpdateDEInverted();
     double GetRATrackRate();
     double GetDETrackRate();
     double GetDefaultRATrackRate();
     double GetDefaultDETrackRate();
-    static void timedguideNSCallback(void *userpointer);
-    static void timedguideWECallback(void *userpointer);
     double GetRASlew();
     double GetDESlew();
     bool gotoInProgress();
@@ -204,12 +250,279 @@ protected:
     uint32_t ah_sHomeIndexPosition_RA, ah_sHomeIndexPosition_DE;
     int ah_waitRA, ah_waitDE;
 
-    // save PPEC status when guiding
-    bool restartguidePPEC;
+    // PPEC is suspended once while guiding and turned on again after a quiet interval without RA pulses
+    bool ppecsuspended;
+    int PPECResumeTimer;
+    void SuspendPPEC();
+    void ResumePPEC();
+    void CancelPPECResume();
+    void PPECResumeTimerHit();
+    static void ppecResumeTimerCallback(void *userpointer);
 
     // One bit for each axis
     uint8_t pulseInProgress;
 
+    // Guide pulses are run by a dedicated thread from one time-ordered queue of start and restore
+    // events for both axes, reports return to the event loop through a pipe
+    typedef struct GuidePulse
+    {
+        bool active, ended, deferred;
+        bool starting;                               // start left to the event loop
+        std::chrono::steady_clock::time_point start; // when the controller got the guide rate
+        double rate, restorerate;                    // arcsecs/s
+        uint32_t requested;                          // ms
+        double achieved;                             // ms, negative when unknown
+        std::chrono::steady_clock::time_point restored; // when the controller got the tracking rate
+        uint32_t merges;                             // pulses merged into this one
+        uint32_t encoderbefore;                      // last polled position at the start
+        uint8_t ppec;                                // 0 off, 1 on, 2 suspended for guiding
+    } GuidePulse;
+    typedef struct GuideEvent
+    {
+        INDI_EQ_AXIS axis;
+        bool restore; // otherwise the start of the pulse
+    } GuideEvent;
+    typedef struct GuideStats
+    {
+        uint32_t pulses {0}, merged {0}, ratechanges {0};
+    } GuideStats;
+    GuidePulse guidepulses[2]; // indexed by INDI_EQ_AXIS
+    GuideStats guidestats;
+    std::multimap<std::chrono::steady_clock::time_point, GuideEvent> guideevents;
+    double guiderestorelead[2]; // seconds from the start of a restore to the controller acting on it
+    std::vector<EQModError> guideerrors;
+    std::thread GuideThread;
+    std::mutex GuideMutex; // guidepulses, guideevents, guidestats, guideerrors and guidethreadexit
+    std::condition_variable GuideCondition;
+    bool guidethreadexit;
+    int guidepipe[2];
+    int GuidePipeCallback;
+    bool StartGuideThread();
+    void StopGuideThread();
+    IPState StartGuidePulse(INDI_EQ_AXIS axis, double rate, uint32_t ms);
+    bool MergeGuidePulse(INDI_EQ_AXIS axis, double rate, uint32_t ms, bool *cancelled);
+    double GuideRestoreLead(INDI_EQ_AXIS axis);
+    void ScheduleGuideRestore(INDI_EQ_AXIS axis, std::chrono::steady_clock::time_point acted);
+    void UpdateGuideStats(const GuideStats &stats);
+    void DropGuideEvents(INDI_EQ_AXIS axis);
+    void RunGuideEvents(const std::vector<GuideEvent> &due);
+    void CancelGuidePulses();
+    void GuidePulsesEnded();
+    void GuideThreadLoop();
+
+    // Continuous guiding: signed rate offsets on top of the tracking rates, with an optional expiry
+    int GuideOffsetTimer;
+    double GuideBaseRate(INDI_EQ_AXIS axis);
+    void SetGuideBaseRate(INDI_EQ_AXIS axis);
+    bool ApplyGuideOffsets();
+    void ClearGuideOffsets();
+    void GuideOffsetsExpired();
+    static void guideOffsetTimerCallback(void *userpointer);
+
+    // Guide pulse telemetry: one record per pulse in a fixed ring, written by the event loop and read
+    // without locks by the BLOB drain timer or through a memory-mapped file by other processes
+    static constexpr uint32_t GUIDE_RING_SIZE {256};
+    static constexpr uint32_t GUIDE_RING_VERSION {1};
+    enum
+    {
+        GUIDE_RECORD_DEFERRED = 1, // tracking rate restored by the event loop
+        GUIDE_RECORD_STEPS    = 2  // DE step guiding move
+    };
+    typedef struct GuideRecord
+    {
+        int64_t start;                        // us, steady clock, guide rate acted on
+        int64_t restored;                     // us, steady clock, tracking rate acted on, 0 when unknown
+        float rate, restorerate;              // arcsecs/s
+        float achieved;                       // ms, negative when unknown
+        uint32_t requested;                   // ms
+        uint32_t encoderbefore, encoderafter; // last polled positions
+        uint8_t axis;                         // INDI_EQ_AXIS
+        uint8_t ppec;                         // 0 off, 1 on, 2 suspended for guiding
+        uint8_t flags;                        // GUIDE_RECORD_*
+        uint8_t merges;                       // pulses merged into this one
+        uint32_t reserved;
+    } GuideRecord;
+    typedef struct GuideRing
+    {
+        char magic[8]; // "EQMODGR"
+        uint32_t version, capacity, recordsize, reserved;
+        std::atomic<uint64_t> head; // records written so far, the last one at (head - 1) % capacity
+        GuideRecord records[GUIDE_RING_SIZE];
+    } GuideRing;
+    GuideRing guideringbuffer;
+    GuideRing *guidering;
+    uint64_t guideringtail; // BLOB drain position
+    GuideRecord guidedrain[GUIDE_RING_SIZE];
+    int guideringfd;
+    int GuideTelemetryTimer;
+    uint8_t GuidePPECState();
+    void InitGuideRing(GuideRing *ring);
+    void RecordGuidePulse(INDI_EQ_AXIS axis, const GuidePulse &pulse, uint8_t flags);
+    bool SetGuideTelemetry(int mode);
+    void CloseGuideTelemetryFile();
+    void DrainGuideTelemetry();
+    static void guideTelemetryTimerCallback(void *userpointer);
+
+    // Guide benchmark against the simulator: random pulses through GuideNorth/South/East/West
+    int GuideBenchTimer;
+    bool guidebenchrunning;
+    uint32_t guidebenchissued;
+    uint64_t guidebenchtail;     // telemetry ring position
+    uint64_t guidebenchcommands; // mount command count at the start
+    std::mt19937 guidebenchrandom;
+    std::vector<double> guidebencherrors;   // achieved - requested, ms
+    std::vector<double> guidebenchblocking; // ms spent in the guide calls
+    std::vector<double> guidebenchpipe;     // ms spent handling the guide thread signals
+    std::vector<double> guidebenchlatency;  // polling timer lateness, ms
+    std::chrono::steady_clock::time_point guidebenchdue;
+    bool StartGuideBenchmark();
+    void GuideBenchmarkStep();
+    void IssueBenchmarkPulse(int direction, uint32_t ms);
+    void CollectBenchmarkRecords();
+    void ScheduleBenchmarkStep();
+    void StopGuideBenchmark(IPState state);
+    void SetBenchmarkMeanMax(const std::vector<double> &values, int index);
+    static void guideBenchTimerCallback(void *userpointer);
+
+    // Fractional tracking periods: the two closest whole periods alternate so that the average rate is exact
+    int DitherTimer;
+    uint32_t ditherperiod[2];   // period last sent, 0 when unknown
+    double ditherphase[2];      // seconds of motion ahead of the exact rate
+    double ditherelapsed[2];    // seconds dithered
+    std::chrono::steady_clock::time_point ditherlast;
+    void ResetDither();
+    void ResetDither(INDI_EQ_AXIS axis);
+    void DitherAxis(INDI_EQ_AXIS axis, double dt);
+    void DitherTimerHit();
+    static void ditherTimerCallback(void *userpointer);
+
+    // DE guiding by lowspeed relative gotos while the DE guide base rate is zero
+    int DEStepGuideTimer;
+    bool destepguiding;
+    double destepremainder; // microsteps carried to the next pulse
+    uint32_t destepqueuedms; // pulses received during the running move
+    uint32_t destepms;
+    double desteprate;
+    uint32_t destepencoder;
+    std::chrono::steady_clock::time_point destepstart;
+    IPState StepGuideDE(double rate, uint32_t ms);
+    IPState StartDEStepMove(double rate, uint32_t ms);
+    void DEStepGuideTimerHit();
+    void StopDEStepGuide();
+    static void deStepGuideTimerCallback(void *userpointer);
+    static void guidePipeCallback(int fd, void *userpointer);
+
+    // Predicted slew durations, refined on measured slews
+    struct timespec slewstarttime;
+    double slewpredicted[2];
+    bool slewmeasuring;
+    void StartSlewDuration(int32_t deltaraencoder, int32_t deltadeencoder);
+    void EndSlewDuration();
+    void UpdateMotionProfiles();
+
+    // Slews started once the asynchronous stops of both axes complete
+    bool PrepareGoto(double r, double d, TelescopePierSide pier, GotoParams *g);
+    bool LaunchGoto(double r, double d, const GotoParams &plan);
+    void StartGotoSlew();
+    void GotoDropped();
+    void StartParkSlew();
+    void ParkDropped();
+
+    // Goto queue: targets visited in order, the next one planned while the current one is tracked
+    typedef struct QueuedTarget
+    {
+        double ra, dec; // hours, degrees
+        double dwell;   // seconds before the next goto, 0 to wait for a Next request
+    } QueuedTarget;
+    std::vector<QueuedTarget> gotoqueue;
+    int gotoqueueindex;
+    bool gotoqueueactive;
+    bool gotoqueueplanned;
+    double gotoqueueplanjd;
+    GotoParams gotoqueueplan;
+    int GotoQueueTimer;
+    bool ParseGotoQueue(const char *text);
+    void PlanQueuedGoto();
+    bool NextQueuedGoto();
+    void GotoQueueArrived();
+    void StopGotoQueue();
+    void UpdateGotoQueue();
+    static void gotoQueueTimerCallback(void *userpointer);
+
+    // Goto calibration: a highspeed then a lowspeed slew out and back on one axis, encoders sampled.
+    // Only the goto period of each speed mode is measured, as velocity factors over the nominal speeds
+    enum CalibrationPhase
+    {
+        CALIBRATION_IDLE,
+        CALIBRATION_HIGH_OUT,
+        CALIBRATION_HIGH_BACK,
+        CALIBRATION_LOW_OUT,
+        CALIBRATION_LOW_BACK
+    };
+    typedef struct CalibrationSample
+    {
+        double time; // seconds since the slew command
+        uint32_t encoder;
+    } CalibrationSample;
+    typedef struct CalibrationResult
+    {
+        double velocity;   // microsteps/s
+        double rampup;     // seconds
+        double rampdown;   // seconds
+        double decelsteps; // microsteps
+    } CalibrationResult;
+    CalibrationPhase calibrationphase;
+    int calibrationaxis;
+    int CalibrationTimer;
+    uint32_t calibrationorigin;
+    int32_t calibrationarc; // signed outward highspeed slew, microsteps
+    struct timespec calibrationstart;
+    std::vector<CalibrationSample> calibrationsamples;
+    CalibrationResult calibrationresults[4];
+    bool StartCalibration(int axis);
+    int32_t CalibrationArc(int axis);
+    bool CalibrationArcSafe(int axis, int32_t delta);
+    void StartCalibrationPhase();
+    void CalibrationTimerHit();
+    bool AnalyzeCalibration(CalibrationResult *result);
+    void FinishCalibration();
+    void CancelCalibration(const char *reason);
+    static void calibrationTimerCallback(void *userpointer);
+
+    // Settle monitor: aux encoders sampled after gotos until the tube stops ringing
+    typedef struct SettleSample
+    {
+        double time; // seconds since the goto ended
+        uint32_t encoder[2];
+    } SettleSample;
+    bool settling;
+    bool settleencodersoff;
+    int SettleTimer;
+    struct timespec settlestart;
+    std::vector<SettleSample> settlesamples;
+    void StartSettle();
+    void SettleTimerHit();
+    double SettleResidual(int axis);
+    void StopSettle(IPState state);
+    static void settleTimerCallback(void *userpointer);
+
+    void EmergencyStop(const struct timespec &abortstart);
+
+    // Single timer firing when tracking is about to reach the RA limit
+    int LimitTimer;
+    double LimitRARate;
+    void ScheduleLimitTimer(double rarate);
+    void CancelLimitTimer();
+    void LimitTimerHit();
+    static void limitTimerCallback(void *userpointer);
+
+#ifdef WITH_SCOPE_LIMITS
+    // Julian date when the sidereal track leaves the horizon limits, 0 when unknown
+    double horizonlimitjd;
+    double horizonlimitra, horizonlimitdec; // position the prediction was made for, hours and degrees
+    void PredictHorizonLimit();
+#endif
+
 public:
     EQMod();
     virtual ~EQMod();
@@ -22,8 +22,13 @@
 #include <indicom.h>
 
 #include <termios.h>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <thread>
+
+thread_local char Skywatcher::command[SKYWATCHER_MAX_CMD];
+thread_local char Skywatcher::response[SKYWATCHER_MAX_CMD];
 
 Skywatcher::Skywatcher(EQMod *t)
 {
@@ -101,6 +106,7 @@ bool Skywatcher::Disconnect()
 
     try
     {
+        CancelPendingMotions();
         StopMotor(Axis1);
         StopMotor(Axis2);
     }
@@ -189,6 +195,7 @@ uint32_t Skywatcher::GetDEEncoderHome()
 
 uint32_t Skywatcher::GetRAPeriod()
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     if (RAPeriod != lastRAPeriod)
     {
         DEBUGF(telescope->DBG_SCOPE_STATUS, "%s() = %ld", __FUNCTION__, static_cast<long>(RAPeriod));
@@ -199,6 +206,7 @@ uint32_t Skywatcher::GetRAPeriod()
 
 uint32_t Skywatcher::GetDEPeriod()
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     if (DEPeriod != lastDEPeriod)
     {
         DEBUGF(telescope->DBG_SCOPE_STATUS, "%s() = %ld", __FUNCTION__, static_cast<long>(DEPeriod));
@@ -602,6 +610,8 @@ void Skywatcher::InquireBoardVersion(char **boardinfo)
     boardinfo[2] = (char *)malloc(5);
     sprintf(boardinfo[2], "0x%02X", MountCode);
     boardinfo[2][4] = '\0';
+
+    SetDefaultMotionProfiles(MountCode, MCVersion);
     
 #ifdef EQMODE_EXT
     SetMountDependantParameter(MountCode);
@@ -831,6 +841,7 @@ void Skywatcher::InquireEncoderInfo(SkywatcherAxis axis, double *steppersvalues)
 
 bool Skywatcher::IsRARunning()
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     CheckMotorStatus(Axis1);
     LOGF_DEBUG("%s() = %s", __FUNCTION__, (RARunning ? "true" : "false"));
     return (RARunning);
@@ -838,13 +849,23 @@ bool Skywatcher::IsRARunning()
 
 bool Skywatcher::IsDERunning()
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     CheckMotorStatus(Axis2);
     LOGF_DEBUG("%s() = %s", __FUNCTION__, (DERunning ? "true" : "false"));
     return (DERunning);
 }
 
+bool Skywatcher::ReadDERunning()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    ReadMotorStatus(Axis2);
+    return (DERunning);
+}
+
 void Skywatcher::ReadMotorStatus(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+
     dispatch_command(GetAxisStatus, axis, nullptr);
     //read_eqmod();
     switch (axis)
@@ -890,6 +911,7 @@ void Skywatcher::ReadMotorStatus(SkywatcherAxis axis)
 
 void Skywatcher::SlewRA(double rate)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double absrate       = fabs(rate);
     uint32_t period = 0;
     bool useHighspeed    = false;
@@ -901,6 +923,12 @@ void Skywatcher::SlewRA(double rate)
     {
         throw EQModError(EQModError::ErrInvalidCmd, "Can not slew while goto is in progress");
     }
+    // A new slew replaces a stop still decelerating, and what was to run after it
+    if (StopPending[Axis1] || BacklashPending[Axis1])
+    {
+        CancelStop(Axis1);
+        StopWaitMotor(Axis1);
+    }
 
     if ((absrate < get_min_rate()) || (absrate > get_max_rate()))
     {
@@ -932,6 +960,7 @@ void Skywatcher::SlewRA(double rate)
 
 void Skywatcher::SlewDE(double rate)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double absrate       = fabs(rate);
     uint32_t period = 0;
     bool useHighspeed    = false;
@@ -943,6 +972,12 @@ void Skywatcher::SlewDE(double rate)
     {
         throw EQModError(EQModError::ErrInvalidCmd, "Can not slew while goto is in progress");
     }
+    // A new slew replaces a stop still decelerating, and what was to run after it
+    if (StopPending[Axis2] || BacklashPending[Axis2])
+    {
+        CancelStop(Axis2);
+        StopWaitMotor(Axis2);
+    }
 
     if ((absrate < get_min_rate()) || (absrate > get_max_rate()))
     {
@@ -978,13 +1013,16 @@ void Skywatcher::SlewDE(double rate)
 
 void Skywatcher::SlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     SkywatcherAxisStatus newstatus;
+    struct timespec setupstart;
+    bool startra = false, startde = false;
     bool useHighSpeed        = false;
-    uint32_t lowperiod = 18, lowspeedmargin = 20000, breaks = 400;
-    /* highperiod = RA 450X DE (+5) 200x, low period 32x */
+    uint32_t breaks = 400;
 
     LOGF_DEBUG("%s() : deltaRA = %d deltaDE = %d", __FUNCTION__, deltaraencoder, deltadeencoder);
 
+    clock_gettime(CLOCK_MONOTONIC, &setupstart);
     newstatus.slewmode = GOTO;
     if (deltaraencoder >= 0)
         newstatus.direction = FORWARD;
@@ -992,7 +1030,7 @@ void Skywatcher::SlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
         newstatus.direction = BACKWARD;
     if (deltaraencoder < 0)
         deltaraencoder = -deltaraencoder;
-    if (deltaraencoder > static_cast<int32_t>(lowspeedmargin))
+    if (deltaraencoder > static_cast<int32_t>(Profiles[Axis1].lowspeedmargin))
         useHighSpeed = true;
     else
         useHighSpeed = false;
@@ -1004,16 +1042,13 @@ void Skywatcher::SlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
     {
         SetMotion(Axis1, newstatus);
         if (useHighSpeed)
-            SetSpeed(Axis1, minperiods[Axis1]);
+            SetSpeed(Axis1, Profiles[Axis1].highperiod);
         else
-            SetSpeed(Axis1, lowperiod);
+            SetSpeed(Axis1, Profiles[Axis1].lowperiod);
         SetTarget(Axis1, deltaraencoder);
-        if (useHighSpeed)
-            breaks = ((deltaraencoder > 3200) ? 3200 : deltaraencoder / 10);
-        else
-            breaks = ((deltaraencoder > 200) ? 200 : deltaraencoder / 10);
+        breaks = GotoBreaks(Axis1, deltaraencoder);
         SetTargetBreaks(Axis1, breaks);
-        StartMotor(Axis1);
+        startra = true;
     }
 
     if (deltadeencoder >= 0)
@@ -1022,7 +1057,7 @@ void Skywatcher::SlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
         newstatus.direction = BACKWARD;
     if (deltadeencoder < 0)
         deltadeencoder = -deltadeencoder;
-    if (deltadeencoder > static_cast<int32_t>(lowspeedmargin))
+    if (deltadeencoder > static_cast<int32_t>(Profiles[Axis2].lowspeedmargin))
         useHighSpeed = true;
     else
         useHighSpeed = false;
@@ -1034,26 +1069,26 @@ void Skywatcher::SlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
     {
         SetMotion(Axis2, newstatus);
         if (useHighSpeed)
-            SetSpeed(Axis2, minperiods[Axis2]);
+            SetSpeed(Axis2, Profiles[Axis2].highperiod);
         else
-            SetSpeed(Axis2, lowperiod);
+            SetSpeed(Axis2, Profiles[Axis2].lowperiod);
         SetTarget(Axis2, deltadeencoder);
-        if (useHighSpeed)
-            breaks = ((deltadeencoder > 3200) ? 3200 : deltadeencoder / 10);
-        else
-            breaks = ((deltadeencoder > 200) ? 200 : deltadeencoder / 10);
+        breaks = GotoBreaks(Axis2, deltadeencoder);
         SetTargetBreaks(Axis2, breaks);
-        StartMotor(Axis2);
+        startde = true;
     }
+    StartMotors(startra, startde, setupstart);
 }
 
 void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bool deup)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     SkywatcherAxisStatus newstatus;
+    struct timespec setupstart;
+    bool startra = false, startde = false;
     bool useHighSpeed = false;
     int32_t deltaraencoder, deltadeencoder;
-    uint32_t lowperiod = 18, lowspeedmargin = 20000, breaks = 400;
-    /* highperiod = RA 450X DE (+5) 200x, low period 32x */
+    uint32_t breaks = 400;
 
     LOGF_DEBUG("%s() : absRA = %ld raup = %c absDE = %ld deup = %c", __FUNCTION__, static_cast<long>(raencoder),
                (raup ? '1' : '0'), static_cast<long>(deencoder), (deup ? '1' : '0'));
@@ -1061,6 +1096,7 @@ void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bo
     deltaraencoder = static_cast<int32_t>(raencoder - RAStep);
     deltadeencoder = static_cast<int32_t>(deencoder - DEStep);
 
+    clock_gettime(CLOCK_MONOTONIC, &setupstart);
     newstatus.slewmode = GOTO;
     if (raup)
         newstatus.direction = FORWARD;
@@ -1068,7 +1104,7 @@ void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bo
         newstatus.direction = BACKWARD;
     if (deltaraencoder < 0)
         deltaraencoder = -deltaraencoder;
-    if (deltaraencoder > static_cast<int32_t>(lowspeedmargin))
+    if (deltaraencoder > static_cast<int32_t>(Profiles[Axis1].lowspeedmargin))
         useHighSpeed = true;
     else
         useHighSpeed = false;
@@ -1080,17 +1116,14 @@ void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bo
     {
         SetMotion(Axis1, newstatus);
         if (useHighSpeed)
-            SetSpeed(Axis1, minperiods[Axis1]);
+            SetSpeed(Axis1, Profiles[Axis1].highperiod);
         else
-            SetSpeed(Axis1, lowperiod);
+            SetSpeed(Axis1, Profiles[Axis1].lowperiod);
         SetAbsTarget(Axis1, raencoder);
-        if (useHighSpeed)
-            breaks = ((deltaraencoder > 3200) ? 3200 : deltaraencoder / 10);
-        else
-            breaks = ((deltaraencoder > 200) ? 200 : deltaraencoder / 10);
+        breaks = GotoBreaks(Axis1, deltaraencoder);
         breaks = (raup ? (raencoder - breaks) : (raencoder + breaks));
         SetAbsTargetBreaks(Axis1, breaks);
-        StartMotor(Axis1);
+        startra = true;
     }
 
     if (deup)
@@ -1099,7 +1132,7 @@ void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bo
         newstatus.direction = BACKWARD;
     if (deltadeencoder < 0)
         deltadeencoder = -deltadeencoder;
-    if (deltadeencoder > static_cast<int32_t>(lowspeedmargin))
+    if (deltadeencoder > static_cast<int32_t>(Profiles[Axis2].lowspeedmargin))
         useHighSpeed = true;
     else
         useHighSpeed = false;
@@ -1111,22 +1144,295 @@ void Skywatcher::AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bo
     {
         SetMotion(Axis2, newstatus);
         if (useHighSpeed)
-            SetSpeed(Axis2, minperiods[Axis2]);
+            SetSpeed(Axis2, Profiles[Axis2].highperiod);
         else
-            SetSpeed(Axis2, lowperiod);
+            SetSpeed(Axis2, Profiles[Axis2].lowperiod);
         SetAbsTarget(Axis2, deencoder);
-        if (useHighSpeed)
-            breaks = ((deltadeencoder > 3200) ? 3200 : deltadeencoder / 10);
-        else
-            breaks = ((deltadeencoder > 200) ? 200 : deltadeencoder / 10);
+        breaks = GotoBreaks(Axis2, deltadeencoder);
         breaks = (deup ? (deencoder - breaks) : (deencoder + breaks));
         SetAbsTargetBreaks(Axis2, breaks);
-        StartMotor(Axis2);
+        startde = true;
+    }
+    StartMotors(startra, startde, setupstart);
+}
+
+/*
+ * Final approach of an iterative goto: lowspeed whatever the increment, decelerating over the
+ * calibrated lowspeed break distance so that the short move ends on target.
+ */
+void Skywatcher::FineSlewTo(int32_t deltaraencoder, int32_t deltadeencoder)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    SkywatcherAxisStatus newstatus;
+    struct timespec setupstart;
+    int32_t deltas[NUMBER_OF_SKYWATCHERAXIS] = { deltaraencoder, deltadeencoder };
+    bool start[NUMBER_OF_SKYWATCHERAXIS]     = { false, false };
+
+    LOGF_DEBUG("%s() : deltaRA = %d deltaDE = %d", __FUNCTION__, deltaraencoder, deltadeencoder);
+
+    clock_gettime(CLOCK_MONOTONIC, &setupstart);
+    newstatus.slewmode  = GOTO;
+    newstatus.speedmode = LOWSPEED;
+    for (int i = Axis1; i < NUMBER_OF_SKYWATCHERAXIS; i++)
+    {
+        SkywatcherAxis axis = static_cast<SkywatcherAxis>(i);
+        uint32_t increment  = static_cast<uint32_t>(std::abs(deltas[i]));
+
+        if (increment == 0)
+            continue;
+        newstatus.direction = (deltas[i] >= 0) ? FORWARD : BACKWARD;
+        SetMotion(axis, newstatus);
+        SetSpeed(axis, Profiles[axis].lowperiod);
+        SetTarget(axis, increment);
+        SetTargetBreaks(axis, FineBreaks(axis, increment));
+        start[i] = true;
+    }
+    StartMotors(start[Axis1], start[Axis2], setupstart);
+}
+
+double Skywatcher::GetRAGotoDuration(int32_t deltaraencoder)
+{
+    return GotoScale[Axis1] * GotoDuration(Axis1, static_cast<uint32_t>(std::abs(deltaraencoder)));
+}
+
+double Skywatcher::GetDEGotoDuration(int32_t deltadeencoder)
+{
+    return GotoScale[Axis2] * GotoDuration(Axis2, static_cast<uint32_t>(std::abs(deltadeencoder)));
+}
+
+double Skywatcher::GetRAFineDuration(int32_t deltaraencoder)
+{
+    uint32_t increment = static_cast<uint32_t>(std::abs(deltaraencoder));
+    return GotoScale[Axis1] * MoveDuration(Axis1, increment, false, FineBreaks(Axis1, increment));
+}
+
+double Skywatcher::GetDEFineDuration(int32_t deltadeencoder)
+{
+    uint32_t increment = static_cast<uint32_t>(std::abs(deltadeencoder));
+    return GotoScale[Axis2] * MoveDuration(Axis2, increment, false, FineBreaks(Axis2, increment));
+}
+
+void Skywatcher::SetRAGotoScale(double scale)
+{
+    GotoScale[Axis1] = scale;
+}
+
+void Skywatcher::SetDEGotoScale(double scale)
+{
+    GotoScale[Axis2] = scale;
+}
+
+// Estimated duration (in seconds) of a goto of increment microsteps, using the speed mode and breaks of SlewTo
+double Skywatcher::GotoDuration(SkywatcherAxis axis, uint32_t increment)
+{
+    bool highspeed = (increment > Profiles[axis].lowspeedmargin);
+    return MoveDuration(axis, increment, highspeed, GotoBreaks(axis, increment));
+}
+
+/*
+ * The motor ramps up to full speed, cruises, and decelerates linearly, either over the calibrated
+ * ramp-down time or over the break steps.
+ */
+double Skywatcher::MoveDuration(SkywatcherAxis axis, uint32_t increment, bool highspeed, uint32_t breaks)
+{
+    double velocity = 0.0, rampup = 0.0, rampdown = 0.0, cruise = 0.0;
+
+    if (increment == 0)
+        return 0.0;
+    velocity = GotoVelocity(axis, highspeed, true);
+    if (velocity <= 0.0)
+        return 0.0;
+    if (highspeed)
+    {
+        rampup   = Profiles[axis].rampup;
+        rampdown = Profiles[axis].rampdown;
+    }
+    if (rampdown <= 0.0)
+        rampdown = 2.0 * breaks / velocity;
+
+    cruise = increment - (velocity * (rampup + rampdown) / 2.0);
+    if (cruise < 0.0)
+    {
+        // Target reached before full speed: triangular profile
+        return sqrt((2.0 * increment * (rampup + rampdown)) / velocity);
+    }
+    return rampup + (cruise / velocity) + rampdown;
+}
+
+// Goto velocity in microsteps/s: timer interrupt frequency over the step period, times the ratio in highspeed
+double Skywatcher::GotoVelocity(SkywatcherAxis axis, bool highspeed, bool calibrated)
+{
+    uint32_t stepsworm      = (axis == Axis1 ? RAStepsWorm : DEStepsWorm);
+    uint32_t highspeedratio = (axis == Axis1 ? RAHighspeedRatio : DEHighspeedRatio);
+    double velocity;
+
+    if (highspeed)
+    {
+        velocity = (static_cast<double>(stepsworm) * highspeedratio) / Profiles[axis].highperiod;
+        if (calibrated)
+            velocity *= Profiles[axis].highfactor;
+    }
+    else
+    {
+        velocity = static_cast<double>(stepsworm) / Profiles[axis].lowperiod;
+        if (calibrated)
+            velocity *= Profiles[axis].lowfactor;
     }
+    return velocity;
+}
+
+// Break distance for a goto of increment microsteps, at most a tenth of short moves
+uint32_t Skywatcher::GotoBreaks(SkywatcherAxis axis, uint32_t increment)
+{
+    uint32_t breaks;
+    if (increment > Profiles[axis].lowspeedmargin)
+        breaks = Profiles[axis].highbreaks;
+    else
+        breaks = Profiles[axis].lowbreaks;
+    return ((increment > breaks) ? breaks : increment / 10);
+}
+
+// Final approach break distance: the measured lowspeed deceleration when calibrated
+uint32_t Skywatcher::FineBreaks(SkywatcherAxis axis, uint32_t increment)
+{
+    uint32_t breaks = (Profiles[axis].finebreaks > 0) ? Profiles[axis].finebreaks : Profiles[axis].lowbreaks;
+    return ((increment > breaks) ? breaks : increment / 10);
+}
+
+/*
+ * Default goto motion profiles are chosen by mount code only, other mounts get the historical SlewTo
+ * values: no firmware dependent break distance is known. Heavy mounts take more distance to decelerate,
+ * light trackers can break over a shorter one. The controller version is only logged.
+ */
+typedef struct MotionProfileDefault
+{
+    uint32_t mountcode;
+    uint32_t lowspeedmargin, lowperiod, lowbreaks, highbreaks;
+    double rampup;
+} MotionProfileDefault;
+
+static const MotionProfileDefault motionprofiledefaults[] =
+{
+    { 0x04, 30000, 18, 400, 6400, 1.5 }, // EQ8
+    { 0x20, 30000, 18, 400, 6400, 1.5 }, // EQ8-R Pro
+    { 0x25, 30000, 18, 400, 6400, 1.5 }, // CQ350 Pro
+    { 0x0A, 10000, 18, 100, 1600, 0.5 }, // Star Adventurer
+    { 0x0C, 10000, 18, 100, 1600, 0.5 }, // Star Adventurer GTi
+    { 0xA5, 10000, 18, 100, 1600, 0.5 }, // AZ-GTi
+};
+
+void Skywatcher::SetDefaultMotionProfiles(uint32_t mountCode, uint32_t mcVersion)
+{
+    const MotionProfileDefault *found = nullptr;
+
+    for (const auto &entry : motionprofiledefaults)
+    {
+        if (entry.mountcode == mountCode)
+        {
+            found = &entry;
+            break;
+        }
+    }
+    for (int axis = Axis1; axis < NUMBER_OF_SKYWATCHERAXIS; axis++)
+    {
+        Profiles[axis].lowspeedmargin = found ? found->lowspeedmargin : SKYWATCHER_GOTO_LOWSPEED_MARGIN;
+        Profiles[axis].lowperiod      = found ? found->lowperiod : SKYWATCHER_GOTO_LOWPERIOD;
+        Profiles[axis].highperiod     = minperiods[axis];
+        Profiles[axis].lowbreaks      = found ? found->lowbreaks : SKYWATCHER_GOTO_LOWSPEED_BREAKS;
+        Profiles[axis].highbreaks     = found ? found->highbreaks : SKYWATCHER_GOTO_HIGHSPEED_BREAKS;
+        Profiles[axis].highfactor     = 1.0;
+        Profiles[axis].lowfactor      = 1.0;
+        Profiles[axis].rampup         = found ? found->rampup : SKYWATCHER_GOTO_RAMPUP;
+        Profiles[axis].rampdown       = 0.0;
+        Profiles[axis].finebreaks     = 0;
+    }
+    DEBUGF(telescope->DBG_MOUNT, "%s() : mount code 0x%02X version %04x: %s goto profiles", __FUNCTION__,
+           mountCode, (mcVersion >> 8), (found ? "mount" : "default"));
+}
+
+void Skywatcher::SetMotionProfile(SkywatcherAxis axis, const MotionProfile &profile)
+{
+    Profiles[axis] = profile;
+    if (Profiles[axis].highperiod < minperiods[axis])
+    {
+        LOGF_WARN("Axis %c highspeed goto period %d is below the minimum, using %d", AxisCmd[axis],
+                  Profiles[axis].highperiod, minperiods[axis]);
+        Profiles[axis].highperiod = minperiods[axis];
+    }
+    if (Profiles[axis].lowperiod == 0)
+        Profiles[axis].lowperiod = SKYWATCHER_GOTO_LOWPERIOD;
+    if (Profiles[axis].highfactor <= 0.0)
+        Profiles[axis].highfactor = 1.0;
+    if (Profiles[axis].lowfactor <= 0.0)
+        Profiles[axis].lowfactor = 1.0;
+    DEBUGF(telescope->DBG_MOUNT,
+           "%s() : Axis = %c -- margin=%d lowperiod=%d highperiod=%d lowbreaks=%d highbreaks=%d "
+           "highfactor=%.3f lowfactor=%.3f rampup=%.2f rampdown=%.2f finebreaks=%d", __FUNCTION__,
+           AxisCmd[axis], Profiles[axis].lowspeedmargin, Profiles[axis].lowperiod, Profiles[axis].highperiod,
+           Profiles[axis].lowbreaks, Profiles[axis].highbreaks, Profiles[axis].highfactor, Profiles[axis].lowfactor,
+           Profiles[axis].rampup, Profiles[axis].rampdown, Profiles[axis].finebreaks);
+}
+
+// Store measured goto velocities (microsteps/s) and highspeed ramp times (s) in the axis profile
+void Skywatcher::CalibrateProfile(SkywatcherAxis axis, double highvelocity, double lowvelocity, double rampup,
+                                  double rampdown)
+{
+    double highnominal = GotoVelocity(axis, true, false);
+    double lownominal  = GotoVelocity(axis, false, false);
+
+    if ((highnominal <= 0.0) || (lownominal <= 0.0))
+        throw EQModError(EQModError::ErrInvalidParameter, "Axis %c: unknown nominal goto velocity", AxisCmd[axis]);
+    Profiles[axis].highfactor = highvelocity / highnominal;
+    Profiles[axis].lowfactor  = lowvelocity / lownominal;
+    Profiles[axis].rampup     = rampup;
+    Profiles[axis].rampdown   = rampdown;
+    DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c -- highspeed %.0f/%.0f lowspeed %.0f/%.0f microsteps/s", __FUNCTION__,
+           AxisCmd[axis], highvelocity, highnominal, lowvelocity, lownominal);
+}
+
+void Skywatcher::CalibrateRAProfile(double highvelocity, double lowvelocity, double rampup, double rampdown)
+{
+    CalibrateProfile(Axis1, highvelocity, lowvelocity, rampup, rampdown);
+}
+
+void Skywatcher::CalibrateDEProfile(double highvelocity, double lowvelocity, double rampup, double rampdown)
+{
+    CalibrateProfile(Axis2, highvelocity, lowvelocity, rampup, rampdown);
+}
+
+Skywatcher::MotionProfile Skywatcher::GetRAMotionProfile()
+{
+    return Profiles[Axis1];
+}
+
+Skywatcher::MotionProfile Skywatcher::GetDEMotionProfile()
+{
+    return Profiles[Axis2];
+}
+
+void Skywatcher::SetRAMotionProfile(const MotionProfile &profile)
+{
+    SetMotionProfile(Axis1, profile);
+}
+
+void Skywatcher::SetDEMotionProfile(const MotionProfile &profile)
+{
+    SetMotionProfile(Axis2, profile);
+}
+
+uint32_t Skywatcher::GetMountCode()
+{
+    return MountCode;
+}
+
+uint32_t Skywatcher::GetMCVersion()
+{
+    return MCVersion;
 }
 
 void Skywatcher::SetRARate(double rate)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double absrate       = fabs(rate);
     uint32_t period = 0;
     bool useHighspeed    = false;
@@ -1156,7 +1462,8 @@ void Skywatcher::SetRARate(double rate)
     else
         newstatus.speedmode = LOWSPEED;
     ReadMotorStatus(Axis1);
-    if (RARunning)
+    // A running takeup is not the motion being changed
+    if (RARunning && !BacklashPending[Axis1])
     {
         if (newstatus.speedmode != RAStatus.speedmode)
             throw EQModError(EQModError::ErrInvalidParameter,
@@ -1171,6 +1478,7 @@ void Skywatcher::SetRARate(double rate)
 
 void Skywatcher::SetDERate(double rate)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double absrate       = fabs(rate);
     uint32_t period = 0;
     bool useHighspeed    = false;
@@ -1200,7 +1508,8 @@ void Skywatcher::SetDERate(double rate)
     else
         newstatus.speedmode = LOWSPEED;
     ReadMotorStatus(Axis2);
-    if (DERunning)
+    // A running takeup is not the motion being changed
+    if (DERunning && !BacklashPending[Axis2])
     {
         if (newstatus.speedmode != DEStatus.speedmode)
             throw EQModError(EQModError::ErrInvalidParameter,
@@ -1215,6 +1524,7 @@ void Skywatcher::SetDERate(double rate)
 
 void Skywatcher::StartRATracking(double trackspeed)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double rate;
     if (trackspeed != 0.0)
         rate = trackspeed / SKYWATCHER_STELLAR_SPEED;
@@ -1234,6 +1544,7 @@ void Skywatcher::StartRATracking(double trackspeed)
 
 void Skywatcher::StartDETracking(double trackspeed)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     double rate;
     if (trackspeed != 0.0)
         rate = trackspeed / SKYWATCHER_STELLAR_SPEED;
@@ -1251,8 +1562,91 @@ void Skywatcher::StartDETracking(double trackspeed)
         StopMotor(Axis2);
 }
 
+bool Skywatcher::GetRATrackingPeriod(double trackspeed, uint32_t *period)
+{
+    return TrackingPeriod(Axis1, trackspeed, period);
+}
+
+bool Skywatcher::GetDETrackingPeriod(double trackspeed, uint32_t *period)
+{
+    return TrackingPeriod(Axis2, trackspeed, period);
+}
+
+void Skywatcher::SetRATrackingPeriod(uint32_t period)
+{
+    SendTrackingPeriod(Axis1, period);
+}
+
+void Skywatcher::SetDETrackingPeriod(uint32_t period)
+{
+    SendTrackingPeriod(Axis2, period);
+}
+
+double Skywatcher::GetRAExactPeriod(double trackspeed)
+{
+    return ExactPeriod(Axis1, trackspeed);
+}
+
+double Skywatcher::GetDEExactPeriod(double trackspeed)
+{
+    return ExactPeriod(Axis2, trackspeed);
+}
+
+double Skywatcher::ExactPeriod(SkywatcherAxis axis, double trackspeed)
+{
+    double absrate     = fabs(trackspeed / SKYWATCHER_STELLAR_SPEED);
+    uint32_t stepsworm = (axis == Axis1) ? RAStepsWorm : DEStepsWorm;
+    uint32_t steps360  = (axis == Axis1) ? RASteps360 : DESteps360;
+
+    if ((absrate < get_min_rate()) || (absrate > SKYWATCHER_LOWSPEED_RATE) || (steps360 == 0))
+        return 0.0;
+    return ((SKYWATCHER_STELLAR_DAY * stepsworm) / static_cast<double>(steps360)) / absrate;
+}
+
+/*
+ * A tracking rate change is a single :I command when the axis already runs a lowspeed slew in
+ * the same direction: the period is computed here, after a status refresh, and sent later with
+ * SendTrackingPeriod. Anything else (stopped axis, direction or speed mode change, goto, pending
+ * stop or backlash takeup) needs the full StartRA/DETracking sequence.
+ */
+bool Skywatcher::TrackingPeriod(SkywatcherAxis axis, double trackspeed, uint32_t *period)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    double rate    = trackspeed / SKYWATCHER_STELLAR_SPEED;
+    double absrate = fabs(rate);
+    SkywatcherAxisStatus *currentstatus = (axis == Axis1) ? &RAStatus : &DEStatus;
+
+    if ((rate == 0.0) || (absrate < get_min_rate()) || (absrate > SKYWATCHER_LOWSPEED_RATE))
+        return false;
+    if (StopPending[axis] || BacklashPending[axis])
+        return false;
+    CheckMotorStatus(axis);
+    if (!((axis == Axis1) ? RARunning : DERunning))
+        return false;
+    if ((currentstatus->slewmode != SLEW) || (currentstatus->speedmode != LOWSPEED) ||
+            (currentstatus->direction != ((rate >= 0.0) ? FORWARD : BACKWARD)))
+        return false;
+    *period = static_cast<uint32_t>(ExactPeriod(axis, trackspeed));
+    return true;
+}
+
+void Skywatcher::SendTrackingPeriod(SkywatcherAxis axis, uint32_t period)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    char cmd[7];
+
+    DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c -- period=%ld", __FUNCTION__, AxisCmd[axis], static_cast<long>(period));
+    long2Revu24str(period, cmd);
+    if (axis == Axis1)
+        RAPeriod = period;
+    else
+        DEPeriod = period;
+    dispatch_command(SetStepPeriod, axis, cmd);
+}
+
 void Skywatcher::SetSpeed(SkywatcherAxis axis, uint32_t period)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     char cmd[7];
     SkywatcherAxisStatus *currentstatus;
 
@@ -1271,6 +1665,16 @@ void Skywatcher::SetSpeed(SkywatcherAxis axis, uint32_t period)
     }
     long2Revu24str(period, cmd);
 
+    // During a backlash takeup the new period is sent when the takeup completes
+    if (BacklashPending[axis])
+    {
+        if (axis == Axis1)
+            RAPeriod = period;
+        else
+            DEPeriod = period;
+        return;
+    }
+
     if ((axis == Axis1) && (RARunning && (currentstatus->slewmode == GOTO || currentstatus->speedmode == HIGHSPEED)))
         throw EQModError(EQModError::ErrInvalidParameter,
                          "Can not change speed while motor is running and in goto or highspeed slew.");
@@ -1574,103 +1978,213 @@ void Skywatcher::SetDEAxisPosition(uint32_t step)
     SetAxisPosition(Axis2, step);
 }
 
+bool Skywatcher::BacklashNeeded(SkywatcherAxis axis)
+{
+    return UseBacklash[axis] && (NewStatus[axis].direction != LastRunningStatus[axis].direction);
+}
+
+/*
+ * Start the axes set up by SlewTo/AbsSlewTo. Use a single common start when both axes support :J3 and
+ * none needs a backlash takeup, otherwise (or if the mount refuses it) start them one after the other.
+ */
+void Skywatcher::StartMotors(bool startra, bool startde, const struct timespec &setupstart)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    struct timespec started;
+    bool common = startra && startde && AxisFeatures[Axis1].hasCommonSlewStart &&
+                  AxisFeatures[Axis2].hasCommonSlewStart && !BacklashNeeded(Axis1) && !BacklashNeeded(Axis2);
+
+    if (startra)
+        CancelStop(Axis1);
+    if (startde)
+        CancelStop(Axis2);
+    if (common)
+    {
+        CheckLoadedPeriod(Axis1);
+        CheckLoadedPeriod(Axis2);
+        try
+        {
+            dispatch_command(StartMotion, AxisBoth, nullptr);
+        }
+        catch (EQModError &e)
+        {
+            if (e.severity == EQModError::ErrDisconnect)
+                throw;
+            LOGF_WARN("Common slew start failed (%s), starting axes separately from now on.", e.message);
+            AxisFeatures[Axis1].hasCommonSlewStart = false;
+            AxisFeatures[Axis2].hasCommonSlewStart = false;
+            common                                 = false;
+        }
+    }
+    if (!common)
+    {
+        if (startra)
+            StartMotor(Axis1);
+        if (startde)
+            StartMotor(Axis2);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    LOGF_DEBUG("%s() : goto start latency %.1f ms (%s start)", __FUNCTION__,
+               ((started.tv_sec - setupstart.tv_sec) * 1000.0) + ((started.tv_nsec - setupstart.tv_nsec) / 1000000.0),
+               (common ? "common" : "separate"));
+}
+
 void Skywatcher::StartMotor(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     bool usebacklash       = UseBacklash[axis];
-    uint32_t backlash = Backlash[axis];
     DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c", __FUNCTION__, AxisCmd[axis]);
 
+    // The takeup still running starts this motion when it completes, see SetMotion
+    if (BacklashPending[axis])
+    {
+        DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c started after the backlash takeup", __FUNCTION__, AxisCmd[axis]);
+        return;
+    }
+    CancelStop(axis);
     if (usebacklash)
     {
         LOGF_INFO("Checking backlash compensation for axis %c", AxisCmd[axis]);
-        if (NewStatus[axis].direction != LastRunningStatus[axis].direction)
+        if (BacklashNeeded(axis))
         {
-            uint32_t currentsteps;
-            char cmd[7];
-            char motioncmd[3] = "20";                                               // lowspeed goto
-            motioncmd[1]      = (NewStatus[axis].direction == FORWARD ? '0' : '1'); // same direction
-            bool *motorrunning;
-            struct timespec wait;
-            LOGF_INFO("Performing backlash compensation for axis %c, microsteps = %d", AxisCmd[axis],
-                      backlash);
-            // Axis Position
-            dispatch_command(GetAxisPosition, axis, nullptr);
-            //read_eqmod();
-            currentsteps = Revu24str2long(response + 1);
-            // Backlash Speed
-            long2Revu24str(backlashperiod[axis], cmd);
-            dispatch_command(SetStepPeriod, axis, cmd);
-            //read_eqmod();
-            // Backlash motion mode
-            dispatch_command(SetMotionMode, axis, motioncmd);
-            //read_eqmod();
-            // Target for backlash
-            long2Revu24str(backlash, cmd);
-            dispatch_command(SetGotoTargetIncrement, axis, cmd);
-            //read_eqmod();
-            // Target breaks for backlash (no break steps)
-            long2Revu24str(backlash / 10, cmd);
-            dispatch_command(SetBreakPointIncrement, axis, cmd);
-            //read_eqmod();
-            // Start Backlash
-            dispatch_command(StartMotion, axis, nullptr);
-            //read_eqmod();
-            // Wait end of backlash
-            if (axis == Axis1)
-                motorrunning = &RARunning;
-            else
-                motorrunning = &DERunning;
-            wait.tv_sec  = 0;
-            wait.tv_nsec = 100000000; // 100ms
-            ReadMotorStatus(axis);
-            while (*motorrunning)
-            {
-                nanosleep(&wait, nullptr);
-                ReadMotorStatus(axis);
-            }
-            // Restore microsteps
-            long2Revu24str(currentsteps, cmd);
-            dispatch_command(SetAxisPositionCmd, axis, cmd);
-            //read_eqmod();
-            // Restore Speed
-            long2Revu24str((axis == Axis1 ? RAPeriod : DEPeriod), cmd);
-            dispatch_command(SetStepPeriod, axis, cmd);
-            //read_eqmod();
-            // Restore motion mode
-            switch (NewStatus[axis].slewmode)
-            {
-                case SLEW:
-                    if (NewStatus[axis].speedmode == LOWSPEED)
-                        motioncmd[0] = '1';
-                    else
-                        motioncmd[0] = '3';
-                    break;
-                case GOTO:
-                    if (NewStatus[axis].speedmode == LOWSPEED)
-                        motioncmd[0] = '2';
-                    else
-                        motioncmd[0] = '0';
-                    break;
-                default:
-                    motioncmd[0] = '1';
-                    break;
-            }
-            dispatch_command(SetMotionMode, axis, motioncmd);
-            //read_eqmod();
-            // Restore Target
-            long2Revu24str(Target[axis], cmd);
-            dispatch_command(SetGotoTargetIncrement, axis, cmd);
-            //read_eqmod();
-            // Restore Target breaks
-            long2Revu24str(TargetBreaks[axis], cmd);
-            dispatch_command(SetBreakPointIncrement, axis, cmd);
-            //read_eqmod();
+            // The axis is started once the takeup completes
+            BeginBacklash(axis);
+            return;
         }
     }
+    CheckLoadedPeriod(axis);
     dispatch_command(StartMotion, axis, nullptr);
     //read_eqmod();
 }
 
+// A start must never run a period left in the controller by a takeup or by an earlier motion
+void Skywatcher::CheckLoadedPeriod(SkywatcherAxis axis)
+{
+    uint32_t period = (axis == Axis1) ? RAPeriod : DEPeriod;
+    char cmd[7];
+
+    if ((LoadedPeriod[axis] == 0) || (LoadedPeriod[axis] == period))
+        return;
+    LOGF_WARN("Axis %c period %u not loaded before the start (controller has %u), sending it", AxisCmd[axis], period,
+              LoadedPeriod[axis]);
+    long2Revu24str(period, cmd);
+    dispatch_command(SetStepPeriod, axis, cmd);
+}
+
+/*
+ * Backlash takeup: a lowspeed goto of the backlash in the new direction, after which the position
+ * is restored and the motion set up by the caller is started. The end of the takeup is polled by
+ * the same timer as asynchronous stops, so both axes may take up their backlash at the same time.
+ */
+void Skywatcher::BeginBacklash(SkywatcherAxis axis)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    uint32_t backlash = Backlash[axis];
+    uint32_t stepsworm = (axis == Axis1 ? RAStepsWorm : DEStepsWorm);
+    char cmd[7];
+    char motioncmd[3] = "20";                                               // lowspeed goto
+    motioncmd[1]      = (NewStatus[axis].direction == FORWARD ? '0' : '1'); // same direction
+
+    LOGF_INFO("Performing backlash compensation for axis %c, microsteps = %d", AxisCmd[axis],
+              backlash);
+    // Axis Position
+    dispatch_command(GetAxisPosition, axis, nullptr);
+    //read_eqmod();
+    BacklashSteps[axis] = Revu24str2long(response + 1);
+    // Backlash Speed
+    long2Revu24str(backlashperiod[axis], cmd);
+    dispatch_command(SetStepPeriod, axis, cmd);
+    //read_eqmod();
+    // Backlash motion mode
+    dispatch_command(SetMotionMode, axis, motioncmd);
+    //read_eqmod();
+    // Target for backlash
+    long2Revu24str(backlash, cmd);
+    dispatch_command(SetGotoTargetIncrement, axis, cmd);
+    //read_eqmod();
+    // Target breaks for backlash (no break steps)
+    long2Revu24str(backlash / 10, cmd);
+    dispatch_command(SetBreakPointIncrement, axis, cmd);
+    //read_eqmod();
+    // Start Backlash
+    dispatch_command(StartMotion, axis, nullptr);
+    //read_eqmod();
+    BacklashPending[axis]   = true;
+    BacklashDirection[axis] = NewStatus[axis].direction;
+    BacklashPredicted[axis] = (stepsworm > 0) ? (static_cast<double>(backlash) * backlashperiod[axis]) / stepsworm : 0.0;
+    ScheduleStopPoll(std::max(SKYWATCHER_STOP_MIN_POLL_MS, static_cast<int>(BacklashPredicted[axis] * 1000.0)));
+}
+
+// Restore the axis setup once the takeup motion has stopped, and start it
+void Skywatcher::FinishBacklash(SkywatcherAxis axis)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    char cmd[7];
+    char motioncmd[3] = "20";
+    motioncmd[1]      = (NewStatus[axis].direction == FORWARD ? '0' : '1');
+
+    BacklashPending[axis] = false;
+    // Restore microsteps
+    long2Revu24str(BacklashSteps[axis], cmd);
+    dispatch_command(SetAxisPositionCmd, axis, cmd);
+    //read_eqmod();
+    // Restore Speed
+    long2Revu24str((axis == Axis1 ? RAPeriod : DEPeriod), cmd);
+    dispatch_command(SetStepPeriod, axis, cmd);
+    //read_eqmod();
+    // Restore motion mode
+    switch (NewStatus[axis].slewmode)
+    {
+        case SLEW:
+            if (NewStatus[axis].speedmode == LOWSPEED)
+                motioncmd[0] = '1';
+            else
+                motioncmd[0] = '3';
+            break;
+        case GOTO:
+            if (NewStatus[axis].speedmode == LOWSPEED)
+                motioncmd[0] = '2';
+            else
+                motioncmd[0] = '0';
+            break;
+        default:
+            motioncmd[0] = '1';
+            break;
+    }
+    dispatch_command(SetMotionMode, axis, motioncmd);
+    //read_eqmod();
+    // Restore Target
+    long2Revu24str(Target[axis], cmd);
+    dispatch_command(SetGotoTargetIncrement, axis, cmd);
+    //read_eqmod();
+    // Restore Target breaks
+    long2Revu24str(TargetBreaks[axis], cmd);
+    dispatch_command(SetBreakPointIncrement, axis, cmd);
+    //read_eqmod();
+    DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c backlash taken up, starting", __FUNCTION__, AxisCmd[axis]);
+    dispatch_command(StartMotion, axis, nullptr);
+    //read_eqmod();
+}
+
+// Stop an unfinished takeup and restore the position it started from
+void Skywatcher::CancelBacklash(SkywatcherAxis axis)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    char cmd[7];
+
+    if (!BacklashPending[axis])
+        return;
+    BacklashPending[axis] = false;
+    LOGF_INFO("Backlash compensation for axis %c cancelled", AxisCmd[axis]);
+    dispatch_command(InstantAxisStop, axis, nullptr);
+    long2Revu24str(BacklashSteps[axis], cmd);
+    dispatch_command(SetAxisPositionCmd, axis, cmd);
+    // Do not leave the backlash speed loaded for the next start
+    long2Revu24str((axis == Axis1 ? RAPeriod : DEPeriod), cmd);
+    dispatch_command(SetStepPeriod, axis, cmd);
+}
+
 void Skywatcher::StopRA()
 {
     LOGF_DEBUG("%s() : calling RA StopWaitMotor", __FUNCTION__);
@@ -1683,8 +2197,351 @@ void Skywatcher::StopDE()
     StopWaitMotor(Axis2);
 }
 
+void Skywatcher::StopRAAsync(StopCallback done)
+{
+    StopAsync(Axis1, done);
+}
+
+void Skywatcher::StopDEAsync(StopCallback done)
+{
+    StopAsync(Axis2, done);
+}
+
+bool Skywatcher::IsMotionPending()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    return StopPending[Axis1] || StopPending[Axis2] || BacklashPending[Axis1] || BacklashPending[Axis2];
+}
+
+// Explicit cancel: the callers end whatever was waiting for both axes
+void Skywatcher::CancelPendingMotions()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    BothStopCallbacks.clear();
+    BothStopDropped.clear();
+    CancelStop(Axis1);
+    CancelStop(Axis2);
+}
+
+/*
+ * Emergency stop: forget the asynchronous stops and takeups, then send the instant stop to both axes
+ * back to back, without reading their status first. A failed stop is only retried once the other
+ * axis got its own. Returns the time until both stops were acknowledged, in ms.
+ */
+double Skywatcher::EmergencyStop()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    struct timespec start, acked;
+    bool stopped[NUMBER_OF_SKYWATCHERAXIS] = { false, false };
+    bool takeup[NUMBER_OF_SKYWATCHERAXIS]  = { BacklashPending[Axis1], BacklashPending[Axis2] };
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // Keep the backlash reference like the other stops, from the last status read: there is no time to read it again
+    if (RARunning && !takeup[Axis1])
+        LastRunningStatus[Axis1] = RAStatus;
+    if (DERunning && !takeup[Axis2])
+        LastRunningStatus[Axis2] = DEStatus;
+    // Explicit stop: nothing to report to the continuations
+    BothStopDropped.clear();
+    DropPendingMotions();
+    for (uint8_t attempt = 0; (attempt < EQMOD_MAX_RETRY) && !(stopped[Axis1] && stopped[Axis2]); attempt++)
+    {
+        for (int i = Axis1; i < NUMBER_OF_SKYWATCHERAXIS; i++)
+        {
+            if (stopped[i])
+                continue;
+            try
+            {
+                dispatch_command(InstantAxisStop, static_cast<SkywatcherAxis>(i), nullptr, 1);
+                stopped[i] = true;
+            }
+            catch (EQModError e)
+            {
+                DEBUGF(telescope->DBG_COMM, "Emergency stop of axis %c failed: %s (attempt %d)", AxisCmd[i], e.message,
+                       attempt);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &acked);
+    if (!stopped[Axis1] || !stopped[Axis2])
+        throw EQModError(EQModError::ErrDisconnect, "emergency stop not acknowledged by axis %c",
+                         AxisCmd[stopped[Axis1] ? Axis2 : Axis1]);
+
+    // Confirm, and restore the positions unfinished takeups started from
+    for (int i = Axis1; i < NUMBER_OF_SKYWATCHERAXIS; i++)
+    {
+        if (takeup[i])
+        {
+            char cmd[7];
+            long2Revu24str(BacklashSteps[i], cmd);
+            dispatch_command(SetAxisPositionCmd, static_cast<SkywatcherAxis>(i), cmd);
+        }
+        ReadMotorStatus(static_cast<SkywatcherAxis>(i));
+    }
+    if (RARunning || DERunning)
+        LOGF_WARN("Emergency stop: axis %s still running after the instant stop", (RARunning ? "RA" : "DE"));
+    return (acked.tv_sec - start.tv_sec) * 1000.0 + (acked.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// Forget pending motions without talking to the mount, after a communication error
+// Callbacks run without IOLock: they may take the guide mutex, which is always taken first
+void Skywatcher::DropPendingMotions()
+{
+    std::vector<StopCallback> dropped;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(IOLock);
+        for (int axis = Axis1; axis < NUMBER_OF_SKYWATCHERAXIS; axis++)
+        {
+            StopPending[axis]     = false;
+            BacklashPending[axis] = false;
+            StopCallbacks[axis].clear();
+        }
+        BothStopCallbacks.clear();
+        dropped.swap(BothStopDropped);
+        if (StopTimer != 0)
+        {
+            IERmTimer(StopTimer);
+            StopTimer = 0;
+        }
+    }
+    RunStopCallbacks(dropped);
+}
+
+void Skywatcher::StopAsync(SkywatcherAxis axis, StopCallback done)
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(IOLock);
+        CancelBacklash(axis);
+        ReadMotorStatus(axis);
+        BeginStop(axis);
+        if (StopPending[axis])
+        {
+            if (done)
+                StopCallbacks[axis].push_back(done);
+            return;
+        }
+    }
+    if (done)
+        done();
+}
+
+/*
+ * Stop both axes: both :K are sent back to back, then a single poll loop waits for both.
+ * done is called once neither axis is stopping any more.
+ */
+void Skywatcher::StopBothAsync(StopCallback done, StopCallback dropped)
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(IOLock);
+        CancelBacklash(Axis1);
+        CancelBacklash(Axis2);
+        ReadMotorStatus(Axis1);
+        ReadMotorStatus(Axis2);
+        try
+        {
+            BeginStop(Axis1);
+        }
+        catch (EQModError &e)
+        {
+            // Do not leave DE running when RA refused the stop
+            BeginStop(Axis2);
+            throw;
+        }
+        BeginStop(Axis2);
+        if (IsMotionPending())
+        {
+            if (done)
+                BothStopCallbacks.push_back(done);
+            if (dropped)
+                BothStopDropped.push_back(dropped);
+            return;
+        }
+    }
+    if (done)
+        done();
+}
+
+/*
+ * Send :K to an axis whose status was just read, if it is running and not already stopping.
+ * The motor status is first polled when the deceleration predicted from the current speed
+ * should be over, then every quarter of that prediction, within the polling bounds.
+ */
+void Skywatcher::BeginStop(SkywatcherAxis axis)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    bool running = (axis == Axis1) ? RARunning : DERunning;
+
+    if (!running || StopPending[axis])
+        return;
+    if (axis == Axis1)
+        LastRunningStatus[Axis1] = RAStatus;
+    else
+        LastRunningStatus[Axis2] = DEStatus;
+    DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c", __FUNCTION__, AxisCmd[axis]);
+    dispatch_command(NotInstantAxisStop, axis, nullptr);
+    StopPredicted[axis] = StopDuration(axis);
+    StopForced[axis]    = false;
+    StopPending[axis]   = true;
+    clock_gettime(CLOCK_MONOTONIC, &StopStart[axis]);
+    ScheduleStopPoll(std::max(SKYWATCHER_STOP_MIN_POLL_MS, static_cast<int>(StopPredicted[axis] * 1000.0)));
+}
+
+// One timer polls every stopping axis: keep the earliest of the requested polls
+void Skywatcher::ScheduleStopPoll(int delay)
+{
+    if (StopTimer != 0)
+    {
+        if (IERemainingTimer(StopTimer) <= delay)
+            return;
+        IERmTimer(StopTimer);
+    }
+    StopTimer = IEAddTimer(delay, (IE_TCF *)stopTimerCallback, this);
+}
+
+void Skywatcher::stopTimerCallback(void *userpointer)
+{
+    Skywatcher *p = ((Skywatcher *)userpointer);
+    p->StopTimer  = 0;
+    p->PollStops();
+}
+
+void Skywatcher::PollStops()
+{
+    std::unique_lock<std::recursive_mutex> lock(IOLock);
+    struct timespec now;
+    std::vector<StopCallback> callbacks, stopped;
+    double elapsed = 0.0;
+    bool running;
+    int delay = SKYWATCHER_STOP_MAX_POLL_MS;
+
+    for (int i = Axis1; i < NUMBER_OF_SKYWATCHERAXIS; i++)
+    {
+        SkywatcherAxis axis = static_cast<SkywatcherAxis>(i);
+        if (BacklashPending[axis])
+        {
+            try
+            {
+                ReadMotorStatus(axis);
+                if ((axis == Axis1) ? RARunning : DERunning)
+                    delay = std::min(delay, std::max(SKYWATCHER_STOP_MIN_POLL_MS,
+                                                     static_cast<int>(BacklashPredicted[axis] * 250.0)));
+                else
+                    FinishBacklash(axis);
+            }
+            catch (EQModError e)
+            {
+                lock.unlock();
+                DropPendingMotions();
+                e.DefaultHandleException(telescope);
+                return;
+            }
+            continue;
+        }
+        if (!StopPending[axis])
+            continue;
+        try
+        {
+            ReadMotorStatus(axis);
+            running = (axis == Axis1) ? RARunning : DERunning;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed = (now.tv_sec - StopStart[axis].tv_sec) + ((now.tv_nsec - StopStart[axis].tv_nsec) / 1e9);
+            if (running)
+            {
+                if ((elapsed > SKYWATCHER_STOP_TIMEOUT) && !StopForced[axis])
+                {
+                    LOGF_WARN("Axis %c still running %.0f s after a stop, forcing an instant stop", AxisCmd[axis],
+                              elapsed);
+                    dispatch_command(InstantAxisStop, axis, nullptr);
+                    StopForced[axis] = true;
+                }
+                delay = std::min(delay, std::max(SKYWATCHER_STOP_MIN_POLL_MS,
+                                                 static_cast<int>(StopPredicted[axis] * 250.0)));
+                continue;
+            }
+        }
+        catch (EQModError e)
+        {
+            lock.unlock();
+            DropPendingMotions();
+            e.DefaultHandleException(telescope);
+            return;
+        }
+
+        DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c stopped in %.2f s (predicted %.2f s)", __FUNCTION__,
+               AxisCmd[axis], elapsed, StopPredicted[axis]);
+        StopPending[axis] = false;
+        stopped.insert(stopped.end(), StopCallbacks[axis].begin(), StopCallbacks[axis].end());
+        StopCallbacks[axis].clear();
+    }
+
+    // Callbacks run without IOLock, see DropPendingMotions
+    lock.unlock();
+    RunStopCallbacks(stopped);
+    lock.lock();
+    if (IsMotionPending())
+    {
+        ScheduleStopPoll(delay);
+        return;
+    }
+    callbacks.swap(BothStopCallbacks);
+    BothStopDropped.clear();
+    lock.unlock();
+    RunStopCallbacks(callbacks);
+}
+
+// Callbacks may stop or start axes again
+void Skywatcher::RunStopCallbacks(std::vector<StopCallback> &callbacks)
+{
+    for (auto &done : callbacks)
+    {
+        try
+        {
+            done();
+        }
+        catch (EQModError e)
+        {
+            e.DefaultHandleException(telescope);
+        }
+    }
+}
+
+void Skywatcher::CancelStop(SkywatcherAxis axis)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    CancelBacklash(axis);
+    if (StopPending[axis])
+        DEBUGF(telescope->DBG_MOUNT, "%s() : Axis = %c pending stop dropped", __FUNCTION__, AxisCmd[axis]);
+    StopPending[axis] = false;
+    StopCallbacks[axis].clear();
+    // Continuations waiting for both axes still run from the next poll
+    if (!IsMotionPending() && BothStopCallbacks.empty() && (StopTimer != 0))
+    {
+        IERmTimer(StopTimer);
+        StopTimer = 0;
+    }
+}
+
+// Predicted deceleration time from the current speed, proportional to the goto ramp at full speed
+double Skywatcher::StopDuration(SkywatcherAxis axis)
+{
+    SkywatcherAxisStatus status = (axis == Axis1) ? RAStatus : DEStatus;
+    uint32_t period             = (axis == Axis1) ? RAPeriod : DEPeriod;
+    double ramp = (Profiles[axis].rampdown > 0.0) ? Profiles[axis].rampdown : Profiles[axis].rampup;
+    double maxvelocity = GotoVelocity(axis, true, true);
+    double velocity;
+
+    if ((period == 0) || (maxvelocity <= 0.0))
+        return 0.0;
+    velocity = static_cast<double>(axis == Axis1 ? RAStepsWorm : DEStepsWorm) / period;
+    if (status.speedmode == HIGHSPEED)
+        velocity *= (axis == Axis1 ? RAHighspeedRatio : DEHighspeedRatio);
+    return ramp * std::min(1.0, velocity / maxvelocity);
+}
+
 void Skywatcher::SetMotion(SkywatcherAxis axis, SkywatcherAxisStatus newstatus)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     char motioncmd[3];
     SkywatcherAxisStatus *currentstatus;
 
@@ -1693,6 +2550,17 @@ void Skywatcher::SetMotion(SkywatcherAxis axis, SkywatcherAxisStatus newstatus)
            ((newstatus.slewmode == SLEW) ? "slew" : "goto"),
            ((newstatus.speedmode == LOWSPEED) ? "lowspeed" : "highspeed"));
 
+    // A slew in the direction of a running takeup replaces what the takeup was to start, anything
+    // else replaces the takeup itself
+    if (BacklashPending[axis])
+    {
+        if ((newstatus.slewmode == SLEW) && (newstatus.direction == BacklashDirection[axis]))
+        {
+            NewStatus[axis] = newstatus;
+            return;
+        }
+        CancelStop(axis);
+    }
     CheckMotorStatus(axis);
     if (axis == Axis1)
         currentstatus = &RAStatus;
@@ -1741,6 +2609,7 @@ void Skywatcher::SetMotion(SkywatcherAxis axis, SkywatcherAxisStatus newstatus)
 
 void Skywatcher::ResetMotions()
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     char motioncmd[3];
     SkywatcherAxisStatus newstatus;
 
@@ -1775,6 +2644,9 @@ void Skywatcher::ResetMotions()
 
 void Skywatcher::StopMotor(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    // A takeup finishing later would start the axis again
+    CancelStop(axis);
     ReadMotorStatus(axis);
     if (axis == Axis1 && RARunning)
         LastRunningStatus[Axis1] = RAStatus;
@@ -1787,6 +2659,9 @@ void Skywatcher::StopMotor(SkywatcherAxis axis)
 
 void Skywatcher::InstantStopMotor(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    // A takeup finishing later would start the axis again
+    CancelStop(axis);
     ReadMotorStatus(axis);
     if (axis == Axis1 && RARunning)
         LastRunningStatus[Axis1] = RAStatus;
@@ -1799,6 +2674,7 @@ void Skywatcher::InstantStopMotor(SkywatcherAxis axis)
 
 void Skywatcher::StopWaitMotor(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     bool *motorrunning;
     struct timespec wait;
     ReadMotorStatus(axis);
@@ -1827,6 +2703,7 @@ void Skywatcher::StopWaitMotor(SkywatcherAxis axis)
 
 void Skywatcher::CheckMotorStatus(SkywatcherAxis axis)
 {
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
     struct timeval now;
     DEBUGF(telescope->DBG_SCOPE_STATUS, "%s() : Axis = %c", __FUNCTION__, AxisCmd[axis]);
     gettimeofday(&now, nullptr);
@@ -1847,7 +2724,14 @@ double Skywatcher::get_max_rate()
 
 bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, char *command_arg)
 {
-    for (uint8_t i = 0; i < EQMOD_MAX_RETRY; i++)
+    return dispatch_command(cmd, axis, command_arg, EQMOD_MAX_RETRY);
+}
+
+bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, char *command_arg, uint8_t attempts)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+
+    for (uint8_t i = 0; i < attempts; i++)
     {
         // Clear string
         command[0] = '\0';
@@ -1859,6 +2743,7 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
                      SkywatcherTrailingChar);
 
         int nbytes_written = 0;
+        std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
         if (!isSimulation())
         {
             int err_code = 0;
@@ -1866,7 +2751,7 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
 
             if ((err_code = tty_write_string(PortFD, command, &nbytes_written)) != TTY_OK)
             {
-                if (i == EQMOD_MAX_RETRY - 1)
+                if (i == attempts - 1)
                 {
                     char ttyerrormsg[ERROR_MSG_LENGTH];
                     tty_error_msg(err_code, ttyerrormsg, ERROR_MSG_LENGTH);
@@ -1884,6 +2769,8 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
         }
         else
         {
+            if (SimulatedLatency > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(SimulatedLatency));
             telescope->simulator->receive_cmd(command, &nbytes_written);
         }
 
@@ -1896,6 +2783,10 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
         {
             if (read_eqmod())
             {
+                CommandCount++;
+                UpdateCommandTiming(cmd, axis, sent);
+                if ((cmd == SetStepPeriod) && (axis != AxisBoth))
+                    LoadedPeriod[axis] = Revu24str2long(command_arg);
                 if (i > 0)
                 {
                     LOGF_WARN("%s() : serial port read failed for %dms (%d retries), verify mount link.", __FUNCTION__,
@@ -1909,7 +2800,7 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
             DEBUGF(telescope->DBG_COMM, "read_eqmod() failed: %s (attempt %i)", ex.message, i);
             // By this time, we just rethrow the error
             // JM 2018-05-07 immediately rethrow if GET_FEATURES_CMD
-            if (i == EQMOD_MAX_RETRY - 1 || cmd == GetFeatureCmd)
+            if (i == attempts - 1 || cmd == GetFeatureCmd)
                 throw;
         }
 
@@ -1919,6 +2810,53 @@ bool Skywatcher::dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, ch
     return true;
 }
 
+void Skywatcher::UpdateCommandTiming(SkywatcherCommand cmd, SkywatcherAxis axis,
+                                     std::chrono::steady_clock::time_point sent)
+{
+    std::chrono::steady_clock::time_point acked = std::chrono::steady_clock::now();
+    double rtt = std::chrono::duration<double>(acked - sent).count();
+
+    if (RoundTripTime == 0.0)
+        RoundTripTime = rtt;
+    else
+        RoundTripTime += SKYWATCHER_RTT_SMOOTHING * (rtt - RoundTripTime);
+    if ((cmd != SetStepPeriod) && (cmd != StartMotion) && (cmd != NotInstantAxisStop) && (cmd != InstantAxisStop))
+        return;
+    for (int i = Axis1; i < NUMBER_OF_SKYWATCHERAXIS; i++)
+        if ((axis == i) || (axis == AxisBoth))
+            MotionCommandTime[i] = sent + (acked - sent) / 2;
+}
+
+double Skywatcher::GetRoundTripTime()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    return RoundTripTime;
+}
+
+uint64_t Skywatcher::GetCommandCount()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    return CommandCount;
+}
+
+void Skywatcher::SetSimulatedLatency(double ms)
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    SimulatedLatency = ms;
+}
+
+std::chrono::steady_clock::time_point Skywatcher::GetRAMotionCommandTime()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    return MotionCommandTime[Axis1];
+}
+
+std::chrono::steady_clock::time_point Skywatcher::GetDEMotionCommandTime()
+{
+    std::lock_guard<std::recursive_mutex> lock(IOLock);
+    return MotionCommandTime[Axis2];
+}
+
 bool Skywatcher::read_eqmod()
 {
     int err_code = 0, nbytes_read = 0;
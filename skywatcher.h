@@ -24,6 +24,10 @@
 
 #include <lilxml.h>
 
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
 #include <time.h>
 #include <sys/time.h>
 
@@ -46,6 +50,19 @@ class EQMod; // TODO
 #define SKYWATCHER_BACKLASH_SPEED_RA 64
 #define SKYWATCHER_BACKLASH_SPEED_DE 64
 
+#define SKYWATCHER_STOP_MIN_POLL_MS 20   /* Motor status polling while an asynchronous stop decelerates */
+#define SKYWATCHER_STOP_MAX_POLL_MS 100
+#define SKYWATCHER_STOP_TIMEOUT     30.0 /* Force an instant stop after that long, seconds */
+
+#define SKYWATCHER_RTT_SMOOTHING 0.1 /* Weight of the last command in the average round trip time */
+
+/* Default goto motion profile (see SetDefaultMotionProfiles) */
+#define SKYWATCHER_GOTO_LOWPERIOD        18
+#define SKYWATCHER_GOTO_LOWSPEED_MARGIN  20000
+#define SKYWATCHER_GOTO_LOWSPEED_BREAKS  200
+#define SKYWATCHER_GOTO_HIGHSPEED_BREAKS 3200
+#define SKYWATCHER_GOTO_RAMPUP           1.0 /* highspeed ramp-up time, seconds */
+
 #define HEX(c) (((c) < 'A') ? ((c) - '0') : ((c) - 'A') + 10)
 
 class Skywatcher
@@ -106,14 +123,70 @@ class Skywatcher
         void SlewDE(double rate);
         void StopRA();
         void StopDE();
+        // Non-blocking stops: done is called from the event loop once the axis is stationary,
+        // or immediately if it already is. Starting the axis again drops the pending callbacks.
+        // Pending motions also include backlash takeups, which a stop cancels.
+        typedef std::function<void()> StopCallback;
+        void StopRAAsync(StopCallback done);
+        void StopDEAsync(StopCallback done);
+        void StopBothAsync(StopCallback done, StopCallback dropped = nullptr);
+        bool IsMotionPending();
+        void CancelPendingMotions();
+        double EmergencyStop();
+        // Command timing, for guide pulses: the controller acts on a command about half a round trip after it is sent
+        double GetRoundTripTime();
+        std::chrono::steady_clock::time_point GetRAMotionCommandTime();
+        std::chrono::steady_clock::time_point GetDEMotionCommandTime();
+        // Benchmarks: commands answered since connection, and a link latency added to simulated commands
+        uint64_t GetCommandCount();
+        void SetSimulatedLatency(double ms);
         void SetRARate(double rate);
         void SetDERate(double rate);
         void SlewTo(int32_t deltaraencoder, int32_t deltadeencoder);
         void AbsSlewTo(uint32_t raencoder, uint32_t deencoder, bool raup, bool deup);
+        void FineSlewTo(int32_t deltaraencoder, int32_t deltadeencoder);
+        double GetRAGotoDuration(int32_t deltaraencoder);
+        double GetDEGotoDuration(int32_t deltadeencoder);
+        double GetRAFineDuration(int32_t deltaraencoder);
+        double GetDEFineDuration(int32_t deltadeencoder);
+        void SetRAGotoScale(double scale);
+        void SetDEGotoScale(double scale);
+
+        // Goto motion profile, one per axis
+        typedef struct MotionProfile
+        {
+            uint32_t lowspeedmargin; // longer gotos use highspeed, microsteps
+            uint32_t lowperiod;      // lowspeed goto period
+            uint32_t highperiod;     // highspeed goto period
+            uint32_t lowbreaks;      // lowspeed break distance, microsteps
+            uint32_t highbreaks;     // highspeed break distance, microsteps
+            double highfactor;       // calibrated highspeed velocity over the nominal one
+            double lowfactor;        // calibrated lowspeed velocity over the nominal one
+            double rampup;           // highspeed ramp-up time, seconds
+            double rampdown;         // highspeed ramp-down time, seconds, 0 to decelerate over the breaks
+            uint32_t finebreaks;     // final approach break distance, microsteps, 0 to use lowbreaks
+        } MotionProfile;
+        MotionProfile GetRAMotionProfile();
+        MotionProfile GetDEMotionProfile();
+        void SetRAMotionProfile(const MotionProfile &profile);
+        void SetDEMotionProfile(const MotionProfile &profile);
+        void CalibrateRAProfile(double highvelocity, double lowvelocity, double rampup, double rampdown);
+        void CalibrateDEProfile(double highvelocity, double lowvelocity, double rampup, double rampdown);
+        uint32_t GetMountCode();
+        uint32_t GetMCVersion();
         void StartRATracking(double trackspeed);
         void StartDETracking(double trackspeed);
+        // Rate changes that only need a new step period: false when StartRA/DETracking is needed
+        bool GetRATrackingPeriod(double trackspeed, uint32_t *period);
+        bool GetDETrackingPeriod(double trackspeed, uint32_t *period);
+        void SetRATrackingPeriod(uint32_t period);
+        void SetDETrackingPeriod(uint32_t period);
+        // Unrounded lowspeed period for a tracking rate, 0 when out of the lowspeed range. No I/O
+        double GetRAExactPeriod(double trackspeed);
+        double GetDEExactPeriod(double trackspeed);
         bool IsRARunning();
         bool IsDERunning();
+        bool ReadDERunning(); // fresh status, not the cached one
         // For AstroEQ (needs an explicit :G command at the end of gotos)
         void ResetMotions();
         void setSimulation(bool);
@@ -202,9 +275,10 @@ class Skywatcher
         {
             Axis1 = 0, // RA/AZ
             Axis2 = 1, // DE/ALT
-            NUMBER_OF_SKYWATCHERAXIS
+            NUMBER_OF_SKYWATCHERAXIS,
+            AxisBoth = NUMBER_OF_SKYWATCHERAXIS // common start (:J3) only
         };
-        char AxisCmd[2] {'1', '2'};
+        char AxisCmd[3] {'1', '2', '3'};
 
         enum SkywatcherDirection
         {
@@ -278,14 +352,41 @@ class Skywatcher
         void ReadMotorStatus(SkywatcherAxis axis);
         void SetMotion(SkywatcherAxis axis, SkywatcherAxisStatus newstatus);
         void SetSpeed(SkywatcherAxis axis, uint32_t period);
+        bool TrackingPeriod(SkywatcherAxis axis, double trackspeed, uint32_t *period);
+        double ExactPeriod(SkywatcherAxis axis, double trackspeed);
+        void SendTrackingPeriod(SkywatcherAxis axis, uint32_t period);
         void SetTarget(SkywatcherAxis axis, uint32_t increment);
         void SetTargetBreaks(SkywatcherAxis axis, uint32_t increment);
         void SetAbsTarget(SkywatcherAxis axis, uint32_t target);
         void SetAbsTargetBreaks(SkywatcherAxis axis, uint32_t breakstep);
         void StartMotor(SkywatcherAxis axis);
+        void CheckLoadedPeriod(SkywatcherAxis axis);
+        void StartMotors(bool startra, bool startde, const struct timespec &setupstart);
+        bool BacklashNeeded(SkywatcherAxis axis);
         void StopMotor(SkywatcherAxis axis);
         void InstantStopMotor(SkywatcherAxis axis);
         void StopWaitMotor(SkywatcherAxis axis);
+        void StopAsync(SkywatcherAxis axis, StopCallback done);
+        void BeginStop(SkywatcherAxis axis);
+        void ScheduleStopPoll(int delay);
+        void PollStops();
+        void RunStopCallbacks(std::vector<StopCallback> &callbacks);
+        void CancelStop(SkywatcherAxis axis);
+        void DropPendingMotions();
+        void BeginBacklash(SkywatcherAxis axis);
+        void FinishBacklash(SkywatcherAxis axis);
+        void CancelBacklash(SkywatcherAxis axis);
+        double StopDuration(SkywatcherAxis axis);
+        static void stopTimerCallback(void *userpointer);
+        double GotoDuration(SkywatcherAxis axis, uint32_t increment);
+        double MoveDuration(SkywatcherAxis axis, uint32_t increment, bool highspeed, uint32_t breaks);
+        uint32_t GotoBreaks(SkywatcherAxis axis, uint32_t increment);
+        uint32_t FineBreaks(SkywatcherAxis axis, uint32_t increment);
+        double GotoVelocity(SkywatcherAxis axis, bool highspeed, bool calibrated);
+        void CalibrateProfile(SkywatcherAxis axis, double highvelocity, double lowvelocity, double rampup,
+                              double rampdown);
+        void SetMotionProfile(SkywatcherAxis axis, const MotionProfile &profile);
+        void SetDefaultMotionProfiles(uint32_t mountCode, uint32_t mcVersion);
         void SetFeature(SkywatcherAxis axis, uint32_t command);
         void GetFeature(SkywatcherAxis axis, uint32_t command);
         void TurnEncoder(SkywatcherAxis axis, bool on);
@@ -300,7 +401,9 @@ class Skywatcher
 #endif
 
         bool read_eqmod();
+        void UpdateCommandTiming(SkywatcherCommand cmd, SkywatcherAxis axis, std::chrono::steady_clock::time_point sent);
         bool dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, char *arg);
+        bool dispatch_command(SkywatcherCommand cmd, SkywatcherAxis axis, char *arg, uint8_t attempts);
 
         uint32_t Revu24str2long(char *);
         uint32_t Highstr2long(char *);
@@ -349,8 +452,9 @@ class Skywatcher
         SkyWatcherFeatures AxisFeatures[NUMBER_OF_SKYWATCHERAXIS];
 
         int PortFD = -1;
-        char command[SKYWATCHER_MAX_CMD];
-        char response[SKYWATCHER_MAX_CMD];
+        // One exchange buffer per thread, replies are parsed after the I/O lock is released
+        static thread_local char command[SKYWATCHER_MAX_CMD];
+        static thread_local char response[SKYWATCHER_MAX_CMD];
 
         bool debug;
         bool debugnextread;
@@ -365,11 +469,37 @@ class Skywatcher
         SkywatcherAxisStatus LastRunningStatus[NUMBER_OF_SKYWATCHERAXIS];
         SkywatcherAxisStatus NewStatus[NUMBER_OF_SKYWATCHERAXIS];
         uint32_t backlashperiod[NUMBER_OF_SKYWATCHERAXIS];
+        double GotoScale[NUMBER_OF_SKYWATCHERAXIS] {1.0, 1.0};
+        MotionProfile Profiles[NUMBER_OF_SKYWATCHERAXIS];
+
+        // Asynchronous stops
+        int StopTimer {0};
+        bool StopPending[NUMBER_OF_SKYWATCHERAXIS] {false, false};
+        bool StopForced[NUMBER_OF_SKYWATCHERAXIS] {false, false};
+        double StopPredicted[NUMBER_OF_SKYWATCHERAXIS] {0.0, 0.0};
+        struct timespec StopStart[NUMBER_OF_SKYWATCHERAXIS];
+        std::vector<StopCallback> StopCallbacks[NUMBER_OF_SKYWATCHERAXIS];
+        std::vector<StopCallback> BothStopCallbacks;
+        std::vector<StopCallback> BothStopDropped; // run instead when a communication error drops the stops
+        // Asynchronous backlash takeups
+        bool BacklashPending[NUMBER_OF_SKYWATCHERAXIS] {false, false};
+        uint32_t BacklashSteps[NUMBER_OF_SKYWATCHERAXIS] {0, 0};
+        double BacklashPredicted[NUMBER_OF_SKYWATCHERAXIS] {0.0, 0.0};
+        SkywatcherDirection BacklashDirection[NUMBER_OF_SKYWATCHERAXIS] {FORWARD, FORWARD};
 
         uint32_t lastreadIndexer[NUMBER_OF_SKYWATCHERAXIS];
 
         bool snapportstatus[NUMBER_OF_SKYWATCHERAXIS];
 
+        // Serializes the mount I/O of the event loop and the guide thread
+        std::recursive_mutex IOLock;
+        // Average command round trip, seconds, and when the last period, start or stop command reached each axis
+        double RoundTripTime {0.0};
+        std::chrono::steady_clock::time_point MotionCommandTime[NUMBER_OF_SKYWATCHERAXIS];
+        uint64_t CommandCount {0};
+        uint32_t LoadedPeriod[NUMBER_OF_SKYWATCHERAXIS] {0, 0}; // last period acknowledged by each axis, 0 if unknown
+        double SimulatedLatency {0.0}; // ms
+
         const long EQMOD_TIMEOUT = 200000; // us
         const uint8_t EQMOD_MAX_RETRY = 10;
 };